@@ -1,10 +1,14 @@
 #include "GomokuGame.h"
-#include <ctime>
-#include <cstdlib>
-#include <unordered_set>
-#include <functional>
+#include <cassert>
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
 #include <algorithm>
+#include <memory>
+#include <thread>
+#include <unordered_set>
 #include "bitBoard.h"
 
 
@@ -19,355 +23,1051 @@ bool operator==(const ChessBoard& a,const ChessBoard& b) noexcept{
     return true;
 }
 
+static double result_value(Player winner) noexcept{     //以黑方视角：胜1.0，负-1.0，平0.0
+    if(winner==Player::None) return 0.0;
+    else if(winner==Player::Black) return 1.0;
+    else return -1.0;
+}
+
+static double proof_value(Proof proof) noexcept{       //已证明的结局按result_value的取值
+    if(proof==Proof::BlackWins) return 1.0;
+    else if(proof==Proof::WhiteWins) return -1.0;
+    else return 0.0;
+}
+
+//根节点挑选落子时，已证明的胜着排在最前，已证明的败着排在最后，其余按访问次数比较
+static int proof_rank(Proof proof,Player player) noexcept{
+    Player opponent=(player==Player::Black)? Player::White:Player::Black;
+    if(proof==win_for(player)) return 2;
+    if(proof==win_for(opponent)) return 0;
+    return 1;
+}
+
+static Board256 stones_of(const ChessBoard& board) noexcept{     //双方棋子合在一起的位棋盘
+    Board256 black,white;
+    place_piece(board,black,white);
+    for(int w=0;w<4;w++){
+        black.word[w]|=white.word[w];
+    }
+    return black;
+}
+
 GomokuGame::GomokuGame(){
-    srand(static_cast<unsigned int>(time(nullptr)));   //初始化随机数种子，用于后续的随机性落子
     StartGame();
 }
 
+GomokuGame::~GomokuGame(){
+    StopPondering();
+    if(telemetry_log!=nullptr) std::fclose(telemetry_log);
+}
 
-void GomokuGame::StartGame(){
-    statemap.reserve(500000);
-    parentmap.reserve(500000);      //防止哈希扩容
 
+void GomokuGame::StartGame(bool open_center){
+    StopPondering();
+    cache.Flush();                  //上一局中途放弃时把已记下的局面写回，并换上上一次写好的文件
     current_board=ChessBoard {};    //初始化棋盘
-    current_board.grid[7][7]=Player::Black;  //AI黑棋先手直接落天元
+    current_key=0;
+    current_player=Player::Black;
+    round=0;
+    if(open_center){
+        current_board.grid[7][7]=Player::Black;  //AI黑棋先手直接落天元
+        current_key=zobrist_of(7,7,Player::Black);
+        current_player=Player::White;   //AI落完天元轮到玩家
+        round=1;
+    }
     diag_map=init_Diag_map();                //初始化对角线映射
-    current_player=Player::White;   //AI落完天元轮到玩家
-    round=1;
+    winner=Player::None;
+    threats.reset(current_board,diag_map);
 
-    statemap.clear();
-    parentmap.clear();
-    //清除数据以供新游戏使用
-    init_ChessBoard_state(current_board);   //添加初始棋盘
+    frame=0;
+    search_tree.clear(current_player,current_key);   //清除数据以供新游戏使用，根节点对应初始棋盘
 }
 
 ChessBoard GomokuGame::GetCurBoard()const noexcept{
     return current_board;
 }
 
+uint64_t GomokuGame::GetCurKey()const noexcept{
+    return current_key;
+}
+
+Player GomokuGame::GetCurPlayer()const noexcept{
+    return current_player;
+}
+
 bool GomokuGame::is_full()noexcept{
     return is_terminal(current_board);
 }
 
-void GomokuGame::reuse(const ChessBoard& board){
-    std::unordered_set<ChessBoard,ChessBoardHash> keep;
+std::size_t GomokuGame::GetTreeSize() const noexcept{
+    return search_tree.node_count();
+}
+
+double GomokuGame::GetTreeBytesPerNode() const noexcept{
+    return search_tree.bytes_per_node();
+}
 
-    keep.reserve(50000);
+std::size_t GomokuGame::GetTreeBytes() const noexcept{
+    return search_tree.bytes_used();
+}
 
-    std::function<void(const ChessBoard&)> dfs= [&](const ChessBoard& b){     //使用lamda表达式写dfs，获取需要保留的节点
-        if(keep.count(b)) return;
-        keep.insert(b);
-        auto it=statemap.find(b);
-        if(it!=statemap.end()){
-            for(const auto& child : it->second.children){
-                dfs(child);
-            }
-        }
-    };
+void GomokuGame::SetSearchConfig(const SearchConfig& config){
+    this->config=config;
+    this->config.threads=std::max(1,config.threads);
+    this->config.batch=std::min(std::max(1,config.batch),MAX_ROLLOUT_BATCH);
+    if(search_tree.transpositions()!=config.transpositions){
+        StopPondering();
+        search_tree.set_transpositions(config.transpositions);
+        frame=0;
+        search_tree.clear(current_player,current_key);      //已有的树没有边统计，重新开始
+    }
+    if(search_tree.amaf()!=(config.rave>0.0)){
+        StopPondering();
+        search_tree.set_amaf(config.rave>0.0);
+        frame=0;
+        search_tree.clear(current_player,current_key);      //已有的边没有AMAF统计
+    }
+    std::size_t capacity=SearchTree::DEFAULT_NODE_CAPACITY;
+    if(config.memory_budget>0) capacity=config.memory_budget/SearchTree::bytes_per_capacity(config.transpositions,config.rave>0.0);
+    if(capacity!=search_tree.capacity()){
+        StopPondering();
+        search_tree.resize(capacity,capacity*SearchTree::EDGES_PER_NODE);     //池在搜索前一次分配好，搜索中不会再增长
+        frame=0;
+        search_tree.clear(current_player,current_key);
+    }
+}
 
-    dfs(board);
+SearchConfig GomokuGame::GetSearchConfig() const noexcept{
+    return config;
+}
 
-    //开始删除
-    for(auto it=statemap.begin();it!=statemap.end();){
-        if(!keep.count(it->first)){
-            parentmap.erase(it->first);
-            it=statemap.erase(it);
-        }
-        else{
-            it++;
+SearchInfo GomokuGame::GetSearchInfo() const noexcept{
+    return last_info;
+}
+
+void GomokuGame::SetProgressCallback(ProgressCallback callback,double interval){
+    progress_callback=std::move(callback);
+    progress_interval=std::max(0.01,interval);
+}
+
+bool GomokuGame::LoadOpeningBook(const std::string& path){
+    return book.Open(path);
+}
+
+bool GomokuGame::EnableSearchCache(const std::string& path,const SearchCacheOptions& options){
+    StopPondering();
+    if(path.empty()){
+        cache.Close();
+        return true;
+    }
+    return cache.Open(path,options);
+}
+
+MoveTelemetry GomokuGame::GetMoveTelemetry() const noexcept{
+    return move_telemetry;
+}
+
+bool GomokuGame::SetTelemetryLog(const std::string& path){
+    if(telemetry_log!=nullptr) std::fclose(telemetry_log);
+    telemetry_log=nullptr;
+    if(path.empty()) return true;
+    telemetry_log=std::fopen(path.c_str(),"a");
+    return telemetry_log!=nullptr;
+}
+
+std::vector<RootMove> GomokuGame::GetRootMoves(){
+    std::vector<RootMove> moves;
+    SearchTree& tree=search_tree;
+    uint32_t root=tree.root();
+    if(tree.root_key()!=zobrist_key(frame_board())||tree[root].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) return moves;
+    double sign=(current_player==Player::Black)? 1.0:-1.0;       //节点统计是黑方视角
+    for(int i=0;i<tree.expanded_of(root);i++){
+        uint32_t edge=tree.edge(root,i).load(std::memory_order_acquire);
+        if(SearchTree::edge_child(edge)==0) continue;
+        uint32_t visits=tree.child_visits(root,i);
+        if(visits==0) continue;
+        uint8_t move=SearchTree::edge_move(edge);
+        std::pair<int,int> real=from_frame({move/BOARD_COLS,move%BOARD_COLS});
+        moves.push_back({real.first,real.second,visits,sign*tree.child_wins(root,i)/visits});
+    }
+    std::sort(moves.begin(),moves.end(),[](const RootMove& a,const RootMove& b){ return a.visits>b.visits; });
+    return moves;
+}
+
+ChessBoard GomokuGame::frame_board() const noexcept{
+    return transform_board(current_board,frame);
+}
+
+std::pair<int,int> GomokuGame::from_frame(std::pair<int,int> move) const noexcept{
+    if(move.first<0||frame==0) return move;
+    int cell=transform_cell(move.first*BOARD_COLS+move.second,inverse_symmetry(frame));
+    return {cell/BOARD_COLS,cell%BOARD_COLS};
+}
+
+void GomokuGame::reuse(int row,int col,Player next,uint64_t key){
+    if(frame==0&&search_tree.child(search_tree.root(),static_cast<uint8_t>(row*BOARD_COLS+col))!=0){
+        search_tree.reroot(static_cast<uint8_t>(row*BOARD_COLS+col),next,key);    //实际落子对应的子树保留，其余节点丢弃
+        return;
+    }
+    //对称局面下树里只扩展了每组等价落子中的一个：实际落子不在树里时，找它在落子前局面的对称变换下的像，
+    //沿那个子节点继续复用，并把这个变换并入frame，此后树坐标系与实际坐标系相差该变换
+    int move=transform_cell(row*BOARD_COLS+col,frame);
+    if(search_tree.child(search_tree.root(),static_cast<uint8_t>(move))==0){
+        ChessBoard before=frame_board();
+        before.grid[move/BOARD_COLS][move%BOARD_COLS]=Player::None;
+        uint8_t group=invariant_symmetries(before);
+        for(int t=1;t<SYMMETRIES;t++){
+            if(!(group>>t&1)) continue;
+            int image=transform_cell(move,t);
+            if(search_tree.child(search_tree.root(),static_cast<uint8_t>(image))!=0){
+                move=image;
+                frame=compose_symmetry(t,frame);
+                break;
+            }
         }
     }
+    search_tree.reroot(static_cast<uint8_t>(move),next,zobrist_key(frame_board()));
+}
 
+void GomokuGame::record_cache(){
+    if(!cache.IsOpen()) return;
+    //树中的键是树坐标系下的，不是对称规范化后的键；Prior按键精确查找，所以只有以后的对局在同一朝向下
+    //走到这个局面时才能命中。坐标系只在对手走了已搜落子的对称像后才偏离实际坐标，多数局面仍按实际朝向记下
+    //访问次数不够的节点，其子孙只会更少，不必再往下走；开启置换时同一节点可能经多条路径到达，只记一次
+    SearchTree& tree=search_tree;
+    std::vector<std::pair<uint32_t,uint64_t>> stack={{tree.root(),tree.root_key()}};
+    std::unordered_set<uint32_t> seen;
+    while(!stack.empty()){
+        uint32_t node=stack.back().first;
+        uint64_t key=stack.back().second;
+        stack.pop_back();
+        const TreeNode& n=tree[node];
+        uint32_t visit=n.visit.load(std::memory_order_relaxed);
+        if(visit<cache.MinVisits()||n.proof.load(std::memory_order_relaxed)!=Proof::Unknown||!seen.insert(node).second) continue;
+        cache.Record(SearchCache::Key(key,n.player),visit,n.win.load(std::memory_order_relaxed));
+        if(n.state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) continue;
+        for(int i=0;i<tree.expanded_of(node);i++){
+            uint32_t edge=tree.edge(node,i).load(std::memory_order_acquire);
+            if(SearchTree::edge_child(edge)==0) continue;
+            uint8_t move=SearchTree::edge_move(edge);
+            stack.push_back({SearchTree::edge_child(edge),key^zobrist_of(move/BOARD_COLS,move%BOARD_COLS,n.player)});
+        }
+    }
 }
 
 bool GomokuGame::Make_Move(int row,int col,Player player){
     if(row<0||row>=BOARD_ROWS||col<0||col>=BOARD_COLS||current_board.grid[row][col]!=Player::None){
         return false;
     }
+    StopPondering();                         //后台搜索停在旧局面上，下面的reroot会保留对应的子树
     current_board.grid[row][col]=player;    //合法位置可以落子
+    current_key^=zobrist_of(row,col,player);
+    if(threats.win_squares(player).test(row,col)) winner=player;     //落子前该格已是成五位点
+    threats.update(row,col,player);
+    current_player=(player==Player::Black)? Player::White:Player::Black;
     round++;
 
-    reuse(current_board);     //落完子后剪去不要的节点
+    TELEMETRY(auto reuse_start=std::chrono::steady_clock::now();)
+    reuse(row,col,current_player,current_key);     //落完子后剪去不要的节点
+    TELEMETRY(reuse_seconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-reuse_start).count();)
+    if(winner!=Player::None||round==BOARD_ROWS*BOARD_COLS) cache.Flush();     //对局结束，后台写回本局记下的局面
 
     return true;
 }
 
 std::pair<int,int> GomokuGame::GetAIMove(){
-    select_range=2;                  //动态更新选择范围
-    if(round>20) select_range+=2;
-    if(round>34) select_range+=1;
-    if(round>54) select_range+=1;
-    if(round>74) select_range+=1;
-    std::pair<int,int> center=cal_center(current_board);
-    ChessBoard bestboard=uctSearch(current_board,Player::Black,center);
-    for(int i=0;i<BOARD_ROWS;i++){
-        for(int j=0;j<BOARD_COLS;j++){
-            if(bestboard.grid[i][j]!=current_board.grid[i][j]){
-                return {i,j};      //返回AI的落子位置
-            }
-        }
+    return GetAIMove(SearchLimits{});
+}
+
+std::pair<int,int> GomokuGame::GetAIMove(const SearchLimits& limits){
+    StopPondering();
+    stop_requested.store(false,std::memory_order_relaxed);
+    return uctSearch(current_board,current_player,limits);
+}
+
+void GomokuGame::StopSearch() noexcept{
+    stop_requested.store(true,std::memory_order_relaxed);
+}
+
+void GomokuGame::StartPondering(){
+    if(ponder_thread.joinable()||winner!=Player::None||is_terminal(current_board)) return;
+    stop_requested.store(false,std::memory_order_relaxed);
+    ChessBoard board=frame_board();
+    uint64_t key=zobrist_key(board);
+    if(search_tree.root_key()!=key||search_tree[search_tree.root()].player!=current_player){
+        frame=0;
+        board=current_board;
+        key=current_key;
+        search_tree.clear(current_player,key);
     }
-    return std::make_pair(-1,-1);    //理论上不会出现
+    SearchLimits unlimited;
+    unlimited.playouts=-1;          //只由StopPondering停止
+    ponder_thread=std::thread([this,board,player=current_player,key,unlimited]{
+        run_search(board,player,key,unlimited);
+    });
+}
+
+void GomokuGame::StopPondering(){
+    if(!ponder_thread.joinable()) return;
+    stop_requested.store(true,std::memory_order_relaxed);
+    ponder_thread.join();
+    stop_requested.store(false,std::memory_order_relaxed);
+}
+
+bool GomokuGame::IsPondering() const noexcept{
+    return ponder_thread.joinable();
 }
 
 Player GomokuGame::CheckWinner() noexcept{
-    if(check_winner(current_board)!=Player::None) return check_winner(current_board);
-    return Player::None;
+    return winner;
 }
 
-std::pair<int,int> GomokuGame::cal_center(const ChessBoard& board,BitBoard black,BitBoard white) noexcept{
-    if(black.is_empty&&white.is_empty) place_piece(board,black,white,diag_map);
-    int x=0,y=0,cnt=0;
-    for(int i=0;i<BOARD_ROWS;i++){
-        cnt+=__builtin_popcount(black.row[i])+__builtin_popcount(white.row[i]);   //获取一行的棋子数
-        while(black.row[i]!=0){
-            x+=i;
-            y+=__builtin_ctz(black.row[i]);
-            black.row[i] &= black.row[i]-1;
-        }
-        while(white.row[i]!=0){
-            x+=i;
-            y+=__builtin_ctz(white.row[i]);
-            white.row[i] &= white.row[i]-1;
-        }
+std::pair<int,int> GomokuGame::uctSearch(const ChessBoard& board,Player player,const SearchLimits& limits){
+    TELEMETRY(decide_start=std::chrono::steady_clock::now();)
+    std::pair<int,int> booked=book.Lookup(board,player);      //开局库优先于启发式和搜索
+    if(booked.first!=-1){
+        last_info=SearchInfo{};
+        return decided(booked,Decision::Book);
     }
-    x=std::round(1.0*x/cnt),y=std::round(1.0*y/cnt);
-    return {x,y};
-}
 
-ChessBoard GomokuGame::uctSearch(const ChessBoard& board,Player player,std::pair<int,int> center){
     //启发式落子
-    ChessBoard bestmove=board;
-
     Player opponent=(player==Player::Black)? Player::White:Player::Black;
     std::pair<int,int> coord={-1,-1};
     if(round>=8){
-        std::pair<bool,std::pair<int,int>> temp1=check_four(board,player);
+        std::pair<bool,std::pair<int,int>> temp1=check_four(player);
         if(temp1.first){
             coord=temp1.second;
         }
         else{
-            std::pair<bool,std::pair<int,int>> temp2=check_four(board,opponent);
+            std::pair<bool,std::pair<int,int>> temp2=check_four(opponent);
             if(temp2.first){
                 coord=temp2.second;
             }
         }
         if(coord.first!=-1){
-            bestmove.grid[coord.first][coord.second]=player;
-            return bestmove;
+            return decided(coord,Decision::Four);
         }
     }
 
     if(round>=6){
-        std::pair<bool,std::pair<int,int>> temp1=check_three(board,player);
+        std::pair<bool,std::pair<int,int>> temp1=check_three(player);
         if(temp1.first){
             coord=temp1.second;
         }
         else{
-            std::pair<bool,std::pair<int,int>> temp2=check_three(board,opponent);
+            std::pair<bool,std::pair<int,int>> temp2=check_three(opponent);
             if(temp2.first){
                 coord=temp2.second;
             }
         }
 
         if(coord.first!=-1){
-            bestmove.grid[coord.first][coord.second]=player;
-            return bestmove;
+            return decided(coord,Decision::Three);
         }
     }
 
     if(round>=8){
-        coord=check_double_thread(board);
+        coord=check_double_thread();
         if(coord.first!=-1){
-            bestmove.grid[coord.first][coord.second]=player;
-            return bestmove;
+            return decided(coord,Decision::DoubleThree);
+        }
+    }
+
+
+    assert(zobrist_key(board)!=current_key||board==current_board);   //键相同而棋盘不同说明发生了冲突，只在调试版检查
+    ChessBoard tree_board=transform_board(board,frame);      //搜索在树坐标系下进行，结果再换回实际坐标
+    uint64_t key=zobrist_key(tree_board);
+    if(search_tree.root_key()!=key||search_tree[search_tree.root()].player!=player){
+        frame=0;                          //根节点与待搜索局面不一致时重建，坐标系也回到实际坐标
+        tree_board=board;
+        key=zobrist_key(board);
+        search_tree.clear(player,key);
+    }
+    if(search_tree[search_tree.root()].proof.load(std::memory_order_relaxed)!=Proof::Unknown&&search_tree.expanded_of(search_tree.root())>0){
+        last_info=SearchInfo{};         //复用的树已经证明了结局，直接按证明落子
+        return decided(from_frame(most_visited(search_tree)),Decision::Solved);
+    }
+
+    TELEMETRY({
+        std::lock_guard<std::mutex> lock(telemetry_mutex);
+        search_telemetry=MoveTelemetry{};      //后台思考合并进来的计数不算在这一步里
+        search_telemetry.thread_seconds[static_cast<int>(Phase::Heuristics)]=std::chrono::duration<double>(std::chrono::steady_clock::now()-decide_start).count();
+    })
+    auto start=std::chrono::steady_clock::now();
+    std::pair<int,int> best=progress_callback? search_with_progress(tree_board,player,key,limits):run_search(tree_board,player,key,limits);
+    last_info.playouts=playouts_done.load(std::memory_order_relaxed);
+    last_info.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    last_info.tree_bytes=search_tree.bytes_used();
+    last_info.evicted=evicted_nodes.load(std::memory_order_relaxed);
+    record_cache();
+    return decided(from_frame(best),Decision::Search);
+}
+
+std::pair<int,int> GomokuGame::decided(std::pair<int,int> move,Decision decision){
+    TELEMETRY(
+        MoveTelemetry record;
+        if(decision==Decision::Search){
+            std::lock_guard<std::mutex> lock(telemetry_mutex);
+            record=search_telemetry;
+        }
+        else record.thread_seconds[static_cast<int>(Phase::Heuristics)]=std::chrono::duration<double>(std::chrono::steady_clock::now()-decide_start).count();
+        record.move_number=round+1;
+        record.row=move.first;
+        record.col=move.second;
+        record.decision=decision;
+        record.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-decide_start).count();
+        record.thread_seconds[static_cast<int>(Phase::Reuse)]=reuse_seconds;
+        reuse_seconds=0.0;
+        if(decision==Decision::Search){
+            record.playouts=last_info.playouts;
+            record.evicted=last_info.evicted;
+            measure_tree(record);
+        }
+        move_telemetry=record;
+        if(telemetry_log!=nullptr){
+            std::fprintf(telemetry_log,"%s\n",record.ToJson().c_str());
+            std::fflush(telemetry_log);
+        }
+    )
+    (void)decision;
+    return move;
+}
+
+void GomokuGame::merge_telemetry(const ThreadTelemetry& counters){
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    counters.merge_into(search_telemetry);
+}
+
+void GomokuGame::measure_tree(MoveTelemetry& record){
+    //与record_cache一样深度优先遍历，开启置换时每个节点只数一次；根并行的其余各树搜索后已经丢弃，只统计search_tree
+    SearchTree& tree=search_tree;
+    std::vector<uint32_t> stack={tree.root()};
+    std::unordered_set<uint32_t> seen;
+    while(!stack.empty()){
+        uint32_t node=stack.back();
+        stack.pop_back();
+        if(tree.transpositions()&&!seen.insert(node).second) continue;
+        record.nodes++;
+        if(tree[node].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) continue;
+        int children=0;
+        for(int i=0;i<tree.expanded_of(node);i++){
+            uint32_t child=SearchTree::edge_child(tree.edge(node,i).load(std::memory_order_acquire));
+            if(child==0) continue;
+            children++;
+            stack.push_back(child);
         }
+        if(children==0) continue;
+        record.internal_nodes++;
+        record.children+=children;
+        record.max_branching=std::max(record.max_branching,children);
     }
+    record.tree_bytes=tree.bytes_used();
+    record.table_slots=tree.table_slots();
+    if(record.table_slots>0) record.table_load=1.0*tree.node_count()/record.table_slots;
+}
 
+void GomokuGame::arm(SearchControl& control,long long playouts,const SearchLimits& limits) const{
+    control.remaining.store(playouts,std::memory_order_relaxed);
+    control.timed=limits.seconds>0.0;
+    if(control.timed){
+        control.deadline=std::chrono::steady_clock::now()+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limits.seconds));
+    }
+}
 
-    if(statemap.find(board)==statemap.end()){
-        init_ChessBoard_state(board);    //如果statemap里没有找到，将其添加进去
+std::pair<int,int> GomokuGame::run_search(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits){
+    playouts_done.store(0,std::memory_order_relaxed);
+    evicted_nodes.store(0,std::memory_order_relaxed);
+    if(config.threads>1&&config.parallel==ParallelMode::Root&&limits.playouts>=0){
+        return root_parallel_search(board,player,key,limits);     //后台思考总是用树并行，根并行多出来的树落子后就没用了
     }
+    long long playouts=limits.playouts;
+    if(playouts==0) playouts=(limits.seconds>0.0)? LLONG_MAX:SELECT_NUM;     //只给时间时不限次数
+    if(playouts<0) playouts=LLONG_MAX;
+    SearchControl control;
+    arm(control,playouts,limits);
+    control.active=config.threads;
+    std::vector<std::thread> workers;
+    for(int t=1;t<config.threads;t++){
+        workers.emplace_back([&]{ search_worker(search_tree,board,player,key,control); });
+    }
+    search_worker(search_tree,board,player,key,control);
+    for(auto& worker : workers){
+        worker.join();
+    }
+    return most_visited(search_tree);
+}
 
-    int cnt=SELECT_NUM;
-    //开始进行多次选择模拟
-    while(cnt--){
-        std::pair<ChessBoard,Player> select_node=Select(board,player,center);    //每次选择都选目前看起来最好的或最需要模拟的节点
+bool GomokuGame::next_playout(SearchTree& tree,SearchControl& control){
+    if(control.remaining.fetch_sub(1,std::memory_order_relaxed)<=0) return false;
+    bool stopped=stop_requested.load(std::memory_order_relaxed)||(control.timed&&std::chrono::steady_clock::now()>=control.deadline)||
+                 tree[tree.root()].proof.load(std::memory_order_relaxed)!=Proof::Unknown;     //根节点已证明，再搜也不会改变落子
+    return !(stopped&&tree.expanded_of(tree.root())>0);     //根节点至少有一个子节点之前不停，保证总有落子可选
+}
+
+void GomokuGame::search_worker(SearchTree& tree,const ChessBoard& board,Player player,uint64_t key,SearchControl& control){
+    if(config.batch>1){
+        batch_worker(tree,board,player,key,control);
+        leave_search(tree,control);
+        return;
+    }
+    //开始进行多次选择模拟，直到预算用完、超时或被要求停止
+    SearchPath path;
+    Board256 stones=stones_of(board);
+    uint8_t symmetries=invariant_symmetries(board);     //每个线程只扫描一次根局面
+    Board256 final_stones[2];               //开启RAVE时记下模拟结束时双方的棋子
+    Board256* amaf=tree.amaf()? final_stones:nullptr;
+    TELEMETRY(ThreadTelemetry counters; PhaseClock clock(counters);)
+    while(next_playout(tree,control)){
+        evict_if_full(tree,control);
+        TELEMETRY(clock.lap(Phase::Evict);)
+        ChessBoard leaf_board=board;
+        Board256 leaf_stones=stones;
+        Player leaf_player=player;
+        uint64_t leaf_key=key;
+        uint32_t leaf=Select(tree,leaf_board,leaf_stones,leaf_player,leaf_key,path,symmetries);    //每次选择都选目前看起来最好的或最需要模拟的节点
+        TELEMETRY(counters.depth(path.depth-1); clock.lap(Phase::Select);)
+        Proof leaf_proof=tree[leaf].proof.load(std::memory_order_acquire);
         for(int i=0;i<SIMULATION_NUM;i++){
-            double value=simulation_method(select_node.first,select_node.second);
-            back_up(select_node.first,board,value);           //反向传播
+            double value;
+            if(leaf_proof!=Proof::Unknown){     //终局或已证明的节点无需模拟
+                value=proof_value(leaf_proof);
+                if(amaf!=nullptr) place_piece(leaf_board,amaf[0],amaf[1]);
+            }
+            else value=simulation_method(leaf_board,leaf_player,amaf);
+            TELEMETRY(clock.lap(Phase::Simulation);)
+            back_up(tree,path,value,amaf);      //反向传播
+            TELEMETRY(clock.lap(Phase::BackUp);)
         }
+        playouts_done.fetch_add(SIMULATION_NUM,std::memory_order_relaxed);
     }
+    TELEMETRY(merge_telemetry(counters);)
+    leave_search(tree,control);
+}
 
-    if(!statemap[board].children.empty()){
-        bestmove=statemap[board].children.front();
-        for(const auto& child : statemap[board].children){
-            if(statemap[bestmove].visit<=statemap[child].visit){      //最终比较探索次数以获取下一步的最佳局面
-                bestmove=child;
+void GomokuGame::batch_worker(SearchTree& tree,const ChessBoard& board,Player player,uint64_t key,SearchControl& control){
+    //先连续Select出一批叶子，路径上的虚拟损失使后面的选择走向别的叶子；整批一起推演后再逐个反向传播
+    ChessBoard boards[MAX_ROLLOUT_BATCH];
+    Player players[MAX_ROLLOUT_BATCH],winners[MAX_ROLLOUT_BATCH];
+    SearchPath paths[MAX_ROLLOUT_BATCH];
+    Board256 final_stones[2*MAX_ROLLOUT_BATCH];
+    Board256* amaf=tree.amaf()? final_stones:nullptr;
+    Board256 stones=stones_of(board);
+    uint8_t symmetries=invariant_symmetries(board);
+    TELEMETRY(ThreadTelemetry counters; PhaseClock clock(counters);)
+    bool more=true;
+    while(more){
+        evict_if_full(tree,control);        //上一批已全部回传，手上没有路径
+        TELEMETRY(clock.lap(Phase::Evict);)
+        int n=0;
+        while(n<config.batch&&(more=next_playout(tree,control))){
+            boards[n]=board;
+            players[n]=player;
+            Board256 leaf_stones=stones;
+            uint64_t leaf_key=key;
+            uint32_t leaf=Select(tree,boards[n],leaf_stones,players[n],leaf_key,paths[n],symmetries);
+            TELEMETRY(counters.depth(paths[n].depth-1);)
+            Proof leaf_proof=tree[leaf].proof.load(std::memory_order_acquire);
+            if(leaf_proof!=Proof::Unknown){             //终局或已证明的节点无需模拟，直接回传
+                if(amaf!=nullptr) place_piece(boards[n],amaf[0],amaf[1]);
+                back_up(tree,paths[n],proof_value(leaf_proof),amaf);
+                playouts_done.fetch_add(1,std::memory_order_relaxed);
+                continue;
             }
+            n++;
+        }
+        TELEMETRY(clock.lap(Phase::Select);)
+        if(n==0) continue;
+        rollout_batch(boards,players,n,thread_rng(),winners,config.rollout,amaf);
+        TELEMETRY(clock.lap(Phase::Simulation);)
+        for(int k=0;k<n;k++){
+            back_up(tree,paths[k],result_value(winners[k]),amaf==nullptr? nullptr:amaf+2*k);
         }
+        TELEMETRY(clock.lap(Phase::BackUp);)
+        playouts_done.fetch_add(n,std::memory_order_relaxed);
     }
+    TELEMETRY(merge_telemetry(counters);)
+}
+
+void GomokuGame::evict_if_full(SearchTree& tree,SearchControl& control){
+    if(config.when_full!=TreeFullPolicy::Evict) return;
+    if(!control.evicting.load(std::memory_order_relaxed)){
+        if(control.frozen.load(std::memory_order_relaxed)||!tree.nearly_full()) return;
+        control.evicting.store(true,std::memory_order_relaxed);     //其他线程在下一次模拟前看到后也来会合
+    }
+    std::unique_lock<std::mutex> lock(control.mutex);
+    if(!control.evicting.load(std::memory_order_relaxed)) return;       //已经有线程整理完了
+    uint64_t generation=control.generation;
+    if(++control.paused==control.active) evict(tree,control);
+    else control.resumed.wait(lock,[&]{ return control.generation!=generation; });
+}
+
+void GomokuGame::leave_search(SearchTree& tree,SearchControl& control){
+    std::lock_guard<std::mutex> lock(control.mutex);
+    control.active--;
+    if(control.evicting.load(std::memory_order_relaxed)&&control.active>0&&control.paused==control.active) evict(tree,control);
+}
 
-    return bestmove;
+void GomokuGame::evict(SearchTree& tree,SearchControl& control){
+    {
+        std::lock_guard<std::mutex> lock(tree_mutex);
+        evicted_nodes.fetch_add(tree.evict(),std::memory_order_relaxed);
+    }
+    control.frozen.store(tree.nearly_full(),std::memory_order_relaxed);      //剩下的都是访问多的节点，腾不出空间，此后只细化
+    control.evicting.store(false,std::memory_order_relaxed);
+    control.paused=0;
+    control.generation++;
+    control.resumed.notify_all();
 }
 
-std::pair<ChessBoard,Player> GomokuGame::Select(ChessBoard board,Player player,std::pair<int,int> center){
-    while(check_winner(board)==Player::None&&!is_terminal(board)){
-        //计算搜索范围的四角坐标
-        int x1=std::max(0,center.first-select_range);
-        int x2=std::min(BOARD_ROWS-1,center.first+select_range);
-        int y1=std::max(0,center.second-select_range);
-        int y2=std::min(BOARD_COLS-1,center.second+select_range);
-        int room=(x2-x1+1)*(y2-y1+1);      //计算总共的搜索空间
-        if(count_piece(board,x1,x2,y1,y2)+statemap[board].children.size()<room){
-            Player p=(player==Player::Black)? Player::White:Player::Black;
-            return std::make_pair(expand(board,player,x1,x2,y1,y2),p);     //如果当前搜索区域落子数和棋盘的子节点之和小于搜索空间，说明未扩展完
+std::pair<int,int> GomokuGame::root_parallel_search(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits){
+    int threads=config.threads;
+    long long playouts=limits.playouts;
+    if(playouts==0) playouts=(limits.seconds>0.0)? LLONG_MAX:SELECT_NUM;
+    std::size_t per_tree=(playouts==LLONG_MAX)? SearchTree::DEFAULT_NODE_CAPACITY:static_cast<std::size_t>(playouts/threads+1);
+    if(config.memory_budget>0) per_tree=std::min(per_tree,search_tree.capacity()/threads);
+    std::vector<std::unique_ptr<SearchTree>> trees;          //0号线程沿用search_tree，保留树复用
+    for(int t=1;t<threads;t++){
+        trees.push_back(std::make_unique<SearchTree>(per_tree,per_tree*SearchTree::EDGES_PER_NODE));
+        trees.back()->set_transpositions(config.transpositions);
+        trees.back()->set_amaf(config.rave>0.0);
+        trees.back()->clear(player,key);
+    }
+    std::unique_ptr<SearchControl[]> controls(new SearchControl[threads]);
+    for(int t=0;t<threads;t++){
+        arm(controls[t],(playouts==LLONG_MAX)? LLONG_MAX:playouts/threads+(t<playouts%threads? 1:0),limits);
+    }
+    std::vector<std::thread> workers;
+    for(int t=1;t<threads;t++){
+        workers.emplace_back([&,t]{ search_worker(*trees[t-1],board,player,key,controls[t]); });
+    }
+    search_worker(search_tree,board,player,key,controls[0]);
+    for(auto& worker : workers){
+        worker.join();
+    }
+
+    uint64_t visits[BOARD_ROWS*BOARD_COLS]={};         //按落子合并各棵树根节点的访问次数
+    int ranks[BOARD_ROWS*BOARD_COLS];                  //任何一棵树证明的结局都成立
+    std::fill(ranks,ranks+BOARD_ROWS*BOARD_COLS,1);
+    auto merge=[&](SearchTree& tree){
+        uint32_t root=tree.root();
+        if(tree[root].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) return;
+        for(int i=0;i<tree.expanded_of(root);i++){
+            uint32_t edge=tree.edge(root,i).load(std::memory_order_acquire);
+            if(SearchTree::edge_child(edge)==0) continue;
+            uint8_t move=SearchTree::edge_move(edge);
+            visits[move]+=tree.child_visits(root,i);
+            int rank=proof_rank(tree[SearchTree::edge_child(edge)].proof.load(std::memory_order_relaxed),player);
+            if(rank!=1) ranks[move]=rank;
         }
-        else{
-            if(statemap[board].children.empty()){
-                break;
-            }
-            ChessBoard temp=board;                          //用临时容器储存board
-            double max_ucb=-1e10;
-            for(const auto& child : statemap[board].children){
-                double child_ucb=UCB(child,player);
-                if(child_ucb>max_ucb){
-                    max_ucb=child_ucb;
-                    board=child;                            //比较ucb值以获取最佳模拟子节点，temp已储存board，board直接用于储存子节点
-                }
-            }
-            parentmap[board]=temp;
-            player=(player==Player::Black)? Player::White:Player::Black;
-        }
-        center=cal_center(board);
-    }
-    Player p=(player==Player::Black)? Player::White:Player::Black;       //返回子节点后要进行模拟，模拟开始时应该为对方落子，所以转换视角
-    return std::make_pair(board,p);
-}
-
-ChessBoard GomokuGame::expand(ChessBoard board,Player player,int x1,int x2,int y1,int y2){
-    ChessBoard temp=board;                                       //用一个中间量方便后续操作
-    for(int i=x1;i<=x2;i++){
-        for(int j=y1;j<=y2;j++){
-            if(temp.grid[i][j]==Player::None){
-                temp.grid[i][j]=player;
-                if(statemap.find(temp)==statemap.end()){
-                    init_ChessBoard_state(temp);
-                    statemap[board].children.push_back(temp);
-                    parentmap[temp]=board;
-                    return temp;
-                }
-                temp.grid[i][j]=Player::None;
-            }
+    };
+    merge(search_tree);
+    for(auto& tree : trees){
+        merge(*tree);
+    }
+    int best=-1;
+    for(int i=0;i<BOARD_ROWS*BOARD_COLS;i++){
+        if(visits[i]>0&&(best==-1||ranks[best]<ranks[i]||(ranks[best]==ranks[i]&&visits[best]<=visits[i]))){
+            best=i;
         }
     }
-    if(!statemap[board].children.empty()){
-        return statemap[board].children[rand()%statemap[board].children.size()];        //前面的循环若没返回，随机返回一个子节点
+    if(best==-1) return {-1,-1};    //理论上不会出现
+    return {best/BOARD_COLS,best%BOARD_COLS};
+}
+
+std::pair<int,int> GomokuGame::search_with_progress(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits){
+    //汇报线程大部分时间在条件变量上等待，只在每个间隔读一次根节点的原子统计，不影响搜索线程
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done=false;
+    auto start=std::chrono::steady_clock::now();
+    auto report=[&](bool finished){
+        SearchProgress progress;
+        {
+            std::lock_guard<std::mutex> lock(tree_mutex);
+            progress=progress_of(search_tree);
+        }
+        progress.seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        progress.finished=finished;
+        progress_callback(progress);
+    };
+    std::thread reporter([&]{
+        auto interval=std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(progress_interval));
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!cv.wait_for(lock,interval,[&]{ return done; })){
+            report(false);
+        }
+    });
+    std::pair<int,int> best=run_search(board,player,key,limits);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done=true;
     }
-    return board;
+    cv.notify_one();
+    reporter.join();
+    report(true);
+    return best;
 }
 
-double GomokuGame::UCB(const ChessBoard& board,Player player) noexcept{
-    if(statemap[board].visit==0) return 1e9;
-    const double c=1.414;
-    double tol_visit=statemap[parentmap[board]].visit;         //从父结点中获取总访问次数
-    double win_rate=statemap[board].win/statemap[board].visit;
-    double node_visit=statemap[board].visit;
-    double search_weight=(c-1.0/2.0*round/(BOARD_ROWS*BOARD_COLS))*sqrt(log(tol_visit+1.0)/(node_visit+1.0));    //加1.0是为了防止log0；
-    return (player==Player::Black)? win_rate+search_weight:-win_rate+search_weight;  //取负转换视角
+SearchProgress GomokuGame::progress_of(SearchTree& tree) const noexcept{
+    SearchProgress progress;
+    progress.playouts=playouts_done.load(std::memory_order_relaxed);
+    uint32_t root=tree.root();
+    progress.root_visits=tree[root].visit.load(std::memory_order_relaxed);
+    if(tree[root].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) return progress;
+    int best_rank=-1;
+    for(int i=0;i<tree.expanded_of(root);i++){
+        uint32_t edge=tree.edge(root,i).load(std::memory_order_acquire);
+        if(SearchTree::edge_child(edge)==0) continue;
+        uint32_t visit=tree.child_visits(root,i);
+        int rank=proof_rank(tree[SearchTree::edge_child(edge)].proof.load(std::memory_order_relaxed),tree[root].player);
+        if(best_rank<rank||(best_rank==rank&&progress.best_visits<=visit)){      //与most_visited的比较规则一致
+            progress.row=SearchTree::edge_move(edge)/BOARD_COLS;
+            progress.col=SearchTree::edge_move(edge)%BOARD_COLS;
+            progress.best_visits=visit;
+            best_rank=rank;
+        }
+    }
+    std::pair<int,int> real=from_frame({progress.row,progress.col});
+    progress.row=real.first;
+    progress.col=real.second;
+    return progress;
 }
 
-double GomokuGame::simulation_method(ChessBoard board,Player player){
-    int range=2;
-    int pieces=count_piece(board,0,BOARD_ROWS-1,0,BOARD_COLS-1);
-    if(pieces>20) range+=2;             //根据传入的节点动态改变搜索范围
-    if(pieces>34) range+=1;
-    if(pieces>54) range+=1;
-    if(pieces>74) range+=1;
-    BitBoard b_black={},b_white={};
-    place_piece(board,b_black,b_white,diag_map);
-    std::pair<int,int> center=cal_center(board,b_black,b_white);
+std::pair<int,int> GomokuGame::most_visited(SearchTree& tree){
+    uint32_t root=tree.root();
+    if(tree[root].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) return {-1,-1};
+    int best=-1,best_rank=-1;
+    uint8_t best_move=0;
+    uint32_t best_visit=0;
+    for(int i=0;i<tree.expanded_of(root);i++){
+        uint32_t edge=tree.edge(root,i).load(std::memory_order_acquire);
+        if(SearchTree::edge_child(edge)==0) continue;
+        uint32_t visit=tree.child_visits(root,i);
+        int rank=proof_rank(tree[SearchTree::edge_child(edge)].proof.load(std::memory_order_relaxed),tree[root].player);
+        if(best_rank<rank||(best_rank==rank&&best_visit<=visit)){      //已证明的胜着优先，其余比较探索次数以获取下一步的最佳落子
+            best=i;
+            best_rank=rank;
+            best_move=SearchTree::edge_move(edge);
+            best_visit=visit;
+        }
+    }
+    if(best==-1) return {-1,-1};    //理论上不会出现
+    return {best_move/BOARD_COLS,best_move%BOARD_COLS};
+}
 
-    int x1=std::max(0,center.first-range);
-    int x2=std::min(BOARD_ROWS-1,center.first+range);
-    int y1=std::max(0,center.second-range);
-    int y2=std::min(BOARD_COLS-1,center.second+range);
+uint32_t GomokuGame::Select(SearchTree& tree,ChessBoard& board,Board256& stones,Player& player,uint64_t& key,SearchPath& path,uint8_t symmetries){
+    uint32_t node=tree.root();
+    tree[node].virtual_loss.fetch_add(1,std::memory_order_relaxed);
+    path.reset(node);
+    while(tree[node].proof.load(std::memory_order_acquire)==Proof::Unknown){
+        if(tree[node].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY&&!init_node(tree,node,board,stones,symmetries)){
+            break;      //其他线程正在生成候选落子，或边池已满，把它当作叶子模拟
+        }
+        bool unexpanded=tree[node].expanded.load(std::memory_order_relaxed)<tree[node].edge_num;
+        if(unexpanded&&config.rave<=0.0){
+            uint32_t child=expand(tree,node,board,stones,key,path);     //候选落子中还有未扩展的，先扩展
+            if(child!=NULL_NODE){
+                player=(player==Player::Black)? Player::White:Player::Black;
+                return child;
+            }
+        }
+        Player opponent=(player==Player::Black)? Player::White:Player::Black;
+        uint32_t best=0;
+        int best_slot=0;
+        double max_ucb=-1e10;
+        for(int i=0;i<tree.expanded_of(node);i++){
+            uint32_t edge=tree.edge(node,i).load(std::memory_order_acquire);
+            if(SearchTree::edge_child(edge)==0) continue;      //子节点还在由其他线程发布
+            if(config.solver&&tree[SearchTree::edge_child(edge)].proof.load(std::memory_order_relaxed)==win_for(opponent)) continue;    //已证明必败的落子不再模拟
+            double child_ucb=UCB(tree,node,i,SearchTree::edge_child(edge),player);
+            if(child_ucb>max_ucb){
+                max_ucb=child_ucb;
+                best=edge;                            //比较ucb值以获取最佳模拟子节点
+                best_slot=i;
+            }
+        }
+        //开启RAVE时未扩展的落子按AMAF估值与已扩展的子节点一起比较，只有它更好时才扩展，AMAF差的落子推迟扩展
+        if(unexpanded&&config.rave>0.0&&(best==0||unexpanded_value(tree,node,player)>max_ucb)){
+            uint32_t child=expand(tree,node,board,stones,key,path);
+            if(child!=NULL_NODE){
+                player=(player==Player::Black)? Player::White:Player::Black;
+                return child;
+            }
+        }
+        if(best==0){
+            if(config.solver&&widen_node(tree,node,stones)) continue;      //候选落子都已证明必败，补进其余空位再选
+            break;      //搜索范围内没有空位（棋盘已满也在此结束），或别的线程正在挑选要扩展的边
+        }
+        uint8_t move=SearchTree::edge_move(best);
+        board.grid[move/BOARD_COLS][move%BOARD_COLS]=player;
+        stones.set(move/BOARD_COLS,move%BOARD_COLS);
+        key^=zobrist_of(move/BOARD_COLS,move%BOARD_COLS,player);
+        if(symmetries!=0) symmetries&=fixing_symmetries(move);      //子局面只保留不移动这一子的对称
+        node=SearchTree::edge_child(best);
+        tree[node].virtual_loss.fetch_add(1,std::memory_order_relaxed);
+        path.push(node,best_slot);
+        player=(player==Player::Black)? Player::White:Player::Black;
+    }
+    return node;     //player已是返回节点局面下的待落子方，模拟从该方落子开始
+}
 
-    std::vector<std::pair<int,int>> center_round;       //获取合法的落子位置
-    std::vector<std::pair<int,int>> whole_board;
+//两格以内的候选落子加上棋子本身所覆盖的格子，空棋盘以天元为中心
+static Board256 candidate_cover(const Board256& stones) noexcept{
+    Board256 origin=stones;
+    if(stones.empty()) origin.set(BOARD_ROWS/2,BOARD_COLS/2);
+    Board256 near=dilate(origin),far=reach2(origin),cover;
+    for(int w=0;w<4;w++){
+        cover.word[w]=near.word[w]|far.word[w]|stones.word[w];
+    }
+    return cover;
+}
 
-    for(int i=0;i<BOARD_ROWS;i++){
-        for(int j=0;j<BOARD_COLS;j++){
-            if(board.grid[i][j]==Player::None){
-                if(i>=x1&&i<=x2&&j>=y1&&j<=y2){
-                    center_round.push_back({i,j});
-                }
-                whole_board.push_back({i,j});
+bool GomokuGame::init_node(SearchTree& tree,uint32_t node,ChessBoard& board,const Board256& stones,uint8_t symmetries){
+    if(tree[node].state.load(std::memory_order_relaxed)!=SearchTree::EDGES_NONE) return false;
+    if(config.solver&&!stones.empty()){
+        //成五点一定紧挨着已有棋子。自己有成五点时下一个就赢；否则对方有成五点时只能去挡，别处落子都输，
+        //两种情况下候选落子都覆盖了所有要紧的落子，MCTS-Solver可以在这里证明负
+        Player player=tree[node].player;
+        Player opponent=(player==Player::Black)? Player::White:Player::Black;
+        Board256 near=dilate(stones);
+        uint8_t threats[BOARD_ROWS*BOARD_COLS];
+        int threat_num=0;
+        for(int w=0;w<4;w++){
+            for(uint64_t bits=near.word[w]&~stones.word[w];bits!=0;bits&=bits-1){
+                int bit=w*64+__builtin_ctzll(bits);
+                int r=bit>>4,c=bit&15;
+                uint8_t move=static_cast<uint8_t>(r*BOARD_COLS+c);
+                board.grid[r][c]=player;
+                bool win=is_five_at(board,r,c);
+                board.grid[r][c]=opponent;
+                bool threat=is_five_at(board,r,c);
+                board.grid[r][c]=Player::None;
+                if(win) return tree.init_edges(node,&move,1,true);
+                if(threat) threats[threat_num++]=move;
             }
         }
+        if(threat_num>0) return tree.init_edges(node,threats,threat_num,true);
     }
-
-    while(true){
-        if(check_winner(board,b_black,b_white)!=Player::None||whole_board.empty()) break;
-
-        auto it2=whole_board.begin()+(rand()%whole_board.size());
-        std::pair<int,int> coord=*it2;
-        while(board.grid[coord.first][coord.second]!=Player::None){        //两个vector当中有重叠的元素，采取lazy_delete的方式
-            std::swap(*it2,whole_board.back());                             //中心区域落子后不急着删除，获取全局落子坐标需要删时再删
-            whole_board.pop_back();
-            if(whole_board.empty()) break;
-            it2=whole_board.begin()+(rand()%whole_board.size());
-            coord=*it2;
-        }
-        if(whole_board.empty()) break;                //删除重叠坐标后，如果empty直接跳出while(true)循环
-
-        if(!center_round.empty()){
-            auto it1=center_round.begin()+(rand()%center_round.size());
-            if(rand()%100<center_round.size()*5){                         //根据中心可落子的点数来设置概率，中心落子点较少时可自动退化成全局落子
-                coord=*it1;
-                if(board.grid[coord.first][coord.second]!=Player::None){   //如果这个点曾在全局落子时下过了，就删除这个点重新循环
-                    std::swap(*it1,center_round.back());
-                    center_round.pop_back();
-                    continue;
-                }
-                std::swap(*it1,center_round.back());
-                center_round.pop_back();
+    //候选落子是紧挨已有棋子的空位，加上沿八个方向隔一格的空位，由棋子位棋盘移位得到；
+    //紧挨的排在前面，expand按边的顺序领取，先扩展它们
+    Board256 origin=stones;
+    if(stones.empty()) origin.set(BOARD_ROWS/2,BOARD_COLS/2);     //空棋盘以天元为中心
+    Board256 near=dilate(origin);
+    Board256 far=reach2(origin);
+    uint64_t rings[3][4];
+    for(int w=0;w<4;w++){
+        rings[0][w]=origin.word[w]&~stones.word[w];     //只有空棋盘时才有：天元本身
+        rings[1][w]=near.word[w]&~origin.word[w];
+        rings[2][w]=far.word[w]&~near.word[w];
+    }
+    uint8_t moves[BOARD_ROWS*BOARD_COLS];
+    int num=0;
+    for(const auto& ring : rings){
+        for(int w=0;w<4;w++){
+            for(uint64_t bits=ring[w];bits!=0;bits&=bits-1){
+                int bit=w*64+__builtin_ctzll(bits);
+                moves[num++]=static_cast<uint8_t>((bit>>4)*BOARD_COLS+(bit&15));
             }
-            else{
-                std::swap(*it2,whole_board.back());
-                whole_board.pop_back();
+        }
+    }
+    uint8_t group=symmetries;      //局面对称时，互为像的候选落子得到的局面等价，每组只保留下标最小的一个
+    if(group!=0){
+        bool candidate[BOARD_ROWS*BOARD_COLS]={};
+        for(int k=0;k<num;k++){
+            candidate[moves[k]]=true;
+        }
+        int kept=0;
+        for(int k=0;k<num;k++){
+            bool representative=true;
+            for(int t=1;t<SYMMETRIES&&representative;t++){
+                int image=transform_cell(moves[k],t);
+                if((group>>t&1)&&candidate[image]&&image<moves[k]) representative=false;
             }
+            if(representative) moves[kept++]=moves[k];
         }
-        else{
-            std::swap(*it2,whole_board.back());
-            whole_board.pop_back();
+        num=kept;
+    }
+    Board256 cover=candidate_cover(stones);       //合并掉的落子与保留的等价，候选落子够到所有空位时也覆盖了所有落子
+    bool all_moves=true;
+    for(int r=0;r<BOARD_ROWS&&all_moves;r++){
+        all_moves=((cover.word[r>>2]>>((r&3)<<4))&0x7FFFu)==0x7FFFu;
+    }
+    return tree.init_edges(node,moves,num,all_moves);
+}
+
+bool GomokuGame::widen_node(SearchTree& tree,uint32_t node,const Board256& stones){
+    TreeNode& n=tree[node];
+    if(n.all_moves.load(std::memory_order_relaxed)||tree.expanded_of(node)<n.edge_num) return false;
+    if(n.picking.exchange(1,std::memory_order_acquire)!=0) return false;       //别的线程正在挑选或补全
+    //持锁后再确认一遍：候选落子全部扩展完且都已证明待落子方必负，才值得把两格以外的空位补进来
+    Proof loss=win_for((n.player==Player::Black)? Player::White:Player::Black);
+    bool lost=!n.all_moves.load(std::memory_order_relaxed)&&tree.expanded_of(node)==n.edge_num;
+    for(int k=0;k<n.edge_num&&lost;k++){
+        uint32_t child=SearchTree::edge_child(tree.edge(node,k).load(std::memory_order_acquire));
+        lost=child!=0&&tree[child].proof.load(std::memory_order_acquire)==loss;
+    }
+    bool widened=false;
+    if(lost){
+        Board256 cover=candidate_cover(stones);
+        uint8_t moves[BOARD_ROWS*BOARD_COLS];
+        int num=0;
+        for(int r=0;r<BOARD_ROWS;r++){
+            for(int c=0;c<BOARD_COLS;c++){
+                if(!cover.test(r,c)) moves[num++]=static_cast<uint8_t>(r*BOARD_COLS+c);
+            }
         }
-        board.grid[coord.first][coord.second]=player;
-        place_a_piece(b_black,b_white,diag_map,coord.first,coord.second,player);
-        player = (player == Player::Black ? Player::White : Player::Black);
+        widened=tree.widen_edges(node,moves,num);
     }
+    n.picking.store(0,std::memory_order_release);
+    return widened;
+}
 
-    if(check_winner(board,b_black,b_white)==Player::None) return 0.0;
-    else if(check_winner(board,b_black,b_white)==Player::Black) return 1.0;
-    else return -1.0;
+uint32_t GomokuGame::expand(SearchTree& tree,uint32_t node,ChessBoard& board,Board256& stones,uint64_t& key,SearchPath& path){
+    int k;
+    if(!tree.amaf()){
+        k=tree[node].expanded.fetch_add(1,std::memory_order_acq_rel);     //领取下一个未扩展的落子
+    }
+    else{       //领取的同时把未扩展的边中AMAF胜率最高的换到这个位置，换边期间其他线程不能领取
+        //不在这里空转等待：别的线程正在挑选时直接放弃扩展，由Select改走已扩展的子节点（没有时就模拟这个节点）
+        if(tree[node].picking.exchange(1,std::memory_order_acquire)!=0) return NULL_NODE;
+        k=tree[node].expanded.fetch_add(1,std::memory_order_acq_rel);
+        int best=k;
+        double best_rate=-2.0;
+        for(int i=k;i<tree[node].edge_num;i++){
+            double rate=amaf_rate(tree,node,i,tree[node].player);
+            if(rate>best_rate){
+                best_rate=rate;
+                best=i;
+            }
+        }
+        if(best!=k) tree.swap_unexpanded(node,k,best);
+        tree[node].picking.store(0,std::memory_order_release);
+    }
+    if(k>=tree[node].edge_num) return NULL_NODE;
+    Player player=tree[node].player;
+    Player next=(player==Player::Black)? Player::White:Player::Black;
+    uint8_t move=SearchTree::edge_move(tree.edge(node,k).load(std::memory_order_relaxed));
+    int r=move/BOARD_COLS,c=move%BOARD_COLS;
+    board.grid[r][c]=player;
+    Proof child_proof=is_five_at(board,r,c)? win_for(player):Proof::Unknown;    //胜负只由新落的这一子决定
+    uint64_t child_key=key^zobrist_of(r,c,player);
+    uint32_t prior_visits=0;
+    int32_t prior_wins=0;
+    if(child_proof==Proof::Unknown) cache.Prior(SearchCache::Key(child_key,next),prior_visits,prior_wins);   //以前的对局搜过这个局面时，从它们的统计起步
+    uint32_t child=tree.find_or_add(node,move,next,child_proof,child_key,prior_visits,prior_wins);
+    if(child==NULL_NODE){                           //节点池已满，不再扩展
+        board.grid[r][c]=Player::None;
+        return NULL_NODE;
+    }
+    key=child_key;
+    stones.set(r,c);
+    tree[child].virtual_loss.fetch_add(1,std::memory_order_relaxed);
+    tree.edge(node,k).store(SearchTree::make_edge(move,child),std::memory_order_release);
+    path.push(child,k);
+    return child;
+}
+
+double GomokuGame::exploration(double parent_visits,double edge_visits) const noexcept{
+    const double c=config.exploration;
+    return (c-1.0/2.0*round/(BOARD_ROWS*BOARD_COLS))*sqrt(log(parent_visits+1.0)/(edge_visits+1.0));    //加1.0是为了防止log0；
+}
+
+double GomokuGame::amaf_rate(const SearchTree& tree,uint32_t parent,int k,Player player) const noexcept{
+    double visit=tree.amaf_visit(parent,k);
+    if(visit==0.0) return 0.0;
+    double win=tree.amaf_win(parent,k);
+    return ((player==Player::Black)? win:-win)/visit;
+}
+
+double GomokuGame::unexpanded_value(const SearchTree& tree,uint32_t node,Player player) const noexcept{
+    double best=-2.0;
+    for(int i=tree[node].expanded.load(std::memory_order_relaxed);i<tree[node].edge_num;i++){
+        best=std::max(best,amaf_rate(tree,node,i,player));
+    }
+    double tol_visit=tree[node].visit.load(std::memory_order_relaxed)+tree[node].virtual_loss.load(std::memory_order_relaxed);
+    return best+exploration(tol_visit,0.0);
+}
+
+double GomokuGame::UCB(const SearchTree& tree,uint32_t parent,int k,uint32_t node,Player player) noexcept{
+    const TreeNode& n=tree[node];
+    double loss=n.virtual_loss.load(std::memory_order_relaxed);
+    double node_visit=n.visit.load(std::memory_order_relaxed)+loss;
+    if(node_visit==0) return 1e9;
+    double tol_visit=tree[parent].visit.load(std::memory_order_relaxed)+tree[parent].virtual_loss.load(std::memory_order_relaxed);   //从父结点中获取总访问次数
+    //开启置换时胜率取子节点汇总了所有路径的统计，探索项只数经过这条边的次数（UCT3），别的路径已经访问过的局面不会被当成这里也探索过了
+    double edge_visit=tree.transpositions()? tree.edge_visit(parent,k)+loss:node_visit;
+    double win=n.win.load(std::memory_order_relaxed);
+    double win_rate=((player==Player::Black)? win-loss:-win-loss)/node_visit;     //取负转换视角，虚拟损失计为落子方的失败
+    if(config.rave>0.0&&tree.amaf_visit(parent,k)>0){
+        //AMAF样本多但有偏：边的访问次数少时主要信它，随访问增多按sqrt(k/(3n+k))逐渐过渡到自身的胜率
+        double beta=sqrt(config.rave/(3.0*edge_visit+config.rave));
+        win_rate=(1.0-beta)*win_rate+beta*amaf_rate(tree,parent,k,player);
+    }
+    return win_rate+exploration(tol_visit,edge_visit);
+}
+
+double GomokuGame::simulation_method(const ChessBoard& board,Player player,Board256* stones){
+    return result_value(rollout(board,player,thread_rng(),config.rollout,stones));
 }
 
-void GomokuGame::back_up(ChessBoard current,const ChessBoard& root,double value){
-    statemap[current].win+=value;
-    statemap[current].visit++;
-    while(!(current==root)){
-        if(parentmap.find(current)==parentmap.end()) break;
-        current=parentmap[current];
-        statemap[current].win+=value;
-        statemap[current].visit++;
+bool GomokuGame::solve(SearchTree& tree,uint32_t node) noexcept{
+    TreeNode& n=tree[node];
+    if(n.proof.load(std::memory_order_acquire)!=Proof::Unknown) return true;
+    if(n.state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) return false;
+    //有一个子节点必胜就够了，与候选落子是否齐全无关；判负或和则要求候选落子覆盖了所有要紧的落子，
+    //否则没列入候选的空位里可能还有出路（见widen_node）
+    Proof win=win_for(n.player);
+    bool complete=n.all_moves.load(std::memory_order_acquire)&&tree.expanded_of(node)==n.edge_num,draw=false;
+    for(int k=0;k<tree.expanded_of(node);k++){
+        uint32_t child=SearchTree::edge_child(tree.edge(node,k).load(std::memory_order_acquire));
+        if(child==0){           //还在由其他线程发布
+            complete=false;
+            continue;
+        }
+        Proof proof=tree[child].proof.load(std::memory_order_acquire);
+        if(proof==win){
+            n.proof.store(win,std::memory_order_release);
+            return true;
+        }
+        if(proof==Proof::Unknown) complete=false;
+        else if(proof==Proof::Draw) draw=true;
     }
+    if(!complete) return false;
+    //子节点的结局不会再变，几个线程同时证明时写入的值相同；没有候选落子说明棋盘已满
+    Player opponent=(n.player==Player::Black)? Player::White:Player::Black;
+    n.proof.store((draw||n.edge_num==0)? Proof::Draw:win_for(opponent),std::memory_order_release);
+    return true;
 }
 
-void GomokuGame:: init_ChessBoard_state(const ChessBoard& board){
-    StateProperty p;
-    p.visit=0.0;
-    p.win=0.0;
-    statemap[board]=p;
+void GomokuGame::back_up(SearchTree& tree,const SearchPath& path,double value,const Board256* stones){
+    bool edges=tree.transpositions();
+    bool solving=config.solver;            //下面的节点证明不了时，上面的节点也不会因这次模拟而得到证明
+    for(int i=path.depth-1;i>=0;i--){
+        uint32_t node=path.node[i];
+        if(solving) solving=solve(tree,node);
+        tree[node].win.fetch_add(static_cast<int32_t>(value),std::memory_order_relaxed);
+        tree[node].visit.fetch_add(1,std::memory_order_relaxed);
+        tree[node].virtual_loss.fetch_sub(1,std::memory_order_relaxed);
+        if(edges&&i>0){             //经由哪条边到达就只记在那条边上
+            tree.edge_win(path.node[i-1],path.slot[i]).fetch_add(static_cast<int32_t>(value),std::memory_order_relaxed);
+            tree.edge_visit(path.node[i-1],path.slot[i]).fetch_add(1,std::memory_order_relaxed);
+        }
+        if(stones==nullptr||tree[node].state.load(std::memory_order_acquire)!=SearchTree::EDGES_READY) continue;
+        //节点的子边都是该局面下的空位，之后被落子方占了的就是这一方在这次模拟里下过的。
+        //AMAF主要用来给未扩展的边排序，所以只扫描未扩展的那一段，再加上路径走过的那条边；
+        //已扩展的边有了自己的统计，它的AMAF停在扩展前的积累上，只作为逐渐淡出的先验，全部扩展完的节点不再扫描
+        const Board256& own=stones[(tree[node].player==Player::Black)? 0:1];
+        for(int k=tree.expanded_of(node);k<tree[node].edge_num;k++){
+            uint8_t move=SearchTree::edge_move(tree.edge(node,k).load(std::memory_order_relaxed));
+            if(!own.test(move/BOARD_COLS,move%BOARD_COLS)) continue;
+            tree.amaf_win(node,k).fetch_add(static_cast<int32_t>(value),std::memory_order_relaxed);
+            tree.amaf_visit(node,k).fetch_add(1,std::memory_order_relaxed);
+        }
+        if(i+1<path.depth){
+            tree.amaf_win(node,path.slot[i+1]).fetch_add(static_cast<int32_t>(value),std::memory_order_relaxed);
+            tree.amaf_visit(node,path.slot[i+1]).fetch_add(1,std::memory_order_relaxed);
+        }
+    }
 }
 
 bool GomokuGame::check_win_on_bitboard(const BitBoard& bitboard)const noexcept{         //五子相连算胜，六子相连不算
@@ -386,6 +1086,10 @@ bool GomokuGame::check_win_on_bitboard(const BitBoard& bitboard)const noexcept{
     return false;
 }
 
+bool GomokuGame::check_win_on_bitboard(const Board256& bitboard)const noexcept{
+    return has_five(bitboard);
+}
+
 bool GomokuGame::is_terminal(const ChessBoard& board)const noexcept{
     bool flag=true;
     for(int i=0;i<BOARD_ROWS;i++){
@@ -400,138 +1104,36 @@ bool GomokuGame::is_terminal(const ChessBoard& board)const noexcept{
 }
 
 Player GomokuGame::check_winner(const ChessBoard& board,BitBoard b_black,BitBoard b_white)const noexcept{
-    if(b_black.is_empty&&b_white.is_empty){
-        place_piece(board,b_black,b_white,diag_map);
+    if(b_black.is_empty&&b_white.is_empty){     //没有现成的位棋盘时改用整盘256位位棋盘
+        Board256 black,white;
+        place_piece(board,black,white);
+        if(check_win_on_bitboard(black)) return Player::Black;
+        if(check_win_on_bitboard(white)) return Player::White;
+        return Player::None;
     }
     if(check_win_on_bitboard(b_black)) return Player::Black;
     if(check_win_on_bitboard(b_white)) return Player::White;
     return Player::None;
 }
 
-int GomokuGame::count_piece(const ChessBoard& board,int r1,int r2,int c1,int c2)const noexcept{
-    int cnt=0;
-    for(int i=r1;i<=r2;i++){
-        for(int j=c1;j<=c2;j++){
-            if(board.grid[i][j]!=Player::None){
-                cnt++;
-            }
-        }
-    }
-    return cnt;
-}
-
-std::pair<bool,std::pair<int,int>> GomokuGame::check_four(const ChessBoard& board,Player player){
-    BitBoard b_black,b_white;
-    place_piece(board,b_black,b_white,diag_map);
-    for(int i=0;i<BOARD_ROWS;i++){
-        for(int j=0;j<BOARD_COLS;j++){
-            if(board.grid[i][j]==Player::None){
-                place_a_piece(b_black,b_white,diag_map,i,j,player);
-                if(check_winner(board,b_black,b_white)==player){
-                    return {true,{i,j}};
-                }
-                erase_a_piece(b_black,b_white,diag_map,i,j,player);
-            }
-        }
-    }
-    return {false,{0,0}};
-}
 
-std::pair<bool,std::pair<int,int>> GomokuGame::check_three(ChessBoard board,Player player){    //自己先落一子，对手再落一子，check_four
-    Player opponent=(player==Player::Black)? Player::White:Player::Black;
-    for(int i=0;i<BOARD_ROWS;i++){
-        for(int j=0;j<BOARD_COLS;j++){
-            if(board.grid[i][j]!=Player::None) continue;
-            board.grid[i][j]=player;
-            bool flag=true;
-            for(int k1=std::max(0,i-4);k1<=std::min(BOARD_ROWS-1,i+4);k1++){             //缩小搜索范围，只在落子点的周围下子
-                for(int k2=std::max(0,j-4);k2<=std::min(BOARD_COLS-1,j+4);k2++){
-                    if(board.grid[k1][k2]!=Player::None) continue;
-                    board.grid[k1][k2]=opponent;
-                    if(check_four(board,player).first==false) flag=false;
-                    board.grid[k1][k2]=Player::None;
-                }
-            }
-            if(flag==true){
-                return {true,{i,j}};
-            }
-            board.grid[i][j]=Player::None;
-        }
-    }
-    return {false,{0,0}};     //未找到
+std::pair<bool,std::pair<int,int>> GomokuGame::check_four(Player player) const noexcept{
+    std::pair<int,int> coord=threats.win_squares(player).first();
+    if(coord.first==-1) return {false,{0,0}};
+    return {true,coord};
 }
 
-void threads(const ChessBoard& board,int i,int j,std::pair<int,int> dr_dc,double& b_threads,double& w_threads){
-    int dr=dr_dc.first,dc=dr_dc.second;
-    Player p1=board.grid[i+dr][j+dc],p2=board.grid[i+dr*2][j+dc*2],
-        p3=board.grid[i+dr*3][j+dc*3],p4=board.grid[i-dr][j-dc];
-
-    if((p1==p2)&&(p3==p4)&&(p3==Player::None)){
-        if(p1==Player::Black) b_threads++;
-        else if(p1==Player::White) w_threads++;
-    }   //OXXOO
-
-    if((p1==p2)&&(p2==p3)&&(p4==Player::None)){
-        if(p1==Player::Black) b_threads++;
-        else if(p1==Player::White) w_threads++;
-    }   //XXXOO
-
-    if((p1==p4)&&(p2==p3)&&(p1==Player::None)){
-        if(p2==Player::Black) b_threads++;
-        else if(p2==Player::White) w_threads++;
-    }   //XXOOO
-
-    if((p1==p2)&&(p2==p4)&&p3==Player::None){
-        if(p1==Player::Black) b_threads++;
-        else if(p1==Player::White) w_threads++;
-    }   //OXXOX
-    if((p1==p3)&&(p3==p4)&&(p2==Player::None)){
-        if(p1==Player::Black) b_threads++;
-        else if(p1==Player::White) w_threads++;
-    }   //XOXOX
-    if((p1==p4)&&(p2==Player::None)){
-        if(p1==Player::Black) b_threads+=0.5;
-        else if(p1==Player::White) w_threads+=0.5;
-    }   //?OXOX  由于对称，另一侧还会再算一遍，所以 +0.5
+std::pair<bool,std::pair<int,int>> GomokuGame::check_three(Player player) const noexcept{    //找落一子即成活四或双冲四的位点，对手无法同时挡住
+    std::pair<int,int> coord=threats.live_four_squares(player).first();
+    if(coord.first==-1) return {false,{0,0}};     //未找到
+    return {true,coord};
 }
 
-std::pair<int,int> GomokuGame::check_double_thread(const ChessBoard& board){
-    double b_threads=0,w_threads=0;
+std::pair<int,int> GomokuGame::check_double_thread() const noexcept{
+    CellSet both=threats.double_three_squares(Player::Black);     //双方的双三位点按行优先取第一个
+    const CellSet& white=threats.double_three_squares(Player::White);
     for(int i=0;i<BOARD_ROWS;i++){
-        for(int j=0;j<BOARD_COLS;j++){
-            if(board.grid[i][j]!=Player::None) continue;
-
-            if(j-3>=0&&j+2<BOARD_COLS){
-                threads(board,i,j,{0,-1},b_threads,w_threads);        //向左延伸
-                if(i-3>=0&&i+2<BOARD_ROWS){
-                    threads(board,i,j,{-1,-1},b_threads,w_threads);   //主对角延伸
-                }
-                if(i+3<BOARD_ROWS&&i-2>=0){
-                    threads(board,i,j,{1,-1},b_threads,w_threads);    //副对角延伸
-                }
-            }
-
-            if(j+3<BOARD_COLS&&j-2>=0){
-                threads(board,i,j,{0,1},b_threads,w_threads);         //向右延伸
-                if(i-3>=0&&i+2<BOARD_ROWS){
-                    threads(board,i,j,{-1,1},b_threads,w_threads);    //副对角延伸
-                }
-                if(i+3<BOARD_ROWS&&i-2>=0){
-                    threads(board,i,j,{1,1},b_threads,w_threads);     //主对角延伸
-                }
-            }
-
-            if(i-3>=0&&i+2<BOARD_ROWS){
-                threads(board,i,j,{-1,0},b_threads,w_threads);        //向上延伸
-            }
-            if(i+3<BOARD_ROWS&&i-2>=0){
-                threads(board,i,j,{1,0},b_threads,w_threads);         //向下延伸
-            }
-
-            if(std::round(b_threads)>=2||std::round(w_threads)>=2) return {i,j};
-            b_threads=0,w_threads=0;
-        }
+        both.row[i]|=white.row[i];
     }
-    return {-1,-1};
+    return both.first();
 }
-
@@ -1,68 +1,239 @@
 #ifndef GOMOKUGAME_H
 #define GOMOKUGAME_H
 
-#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include "config.h"
+#include "searchTree.h"
+#include "threatIndex.h"
+#include "board256.h"
+#include "rollout.h"
+#include "openingBook.h"
+#include "searchCache.h"
+#include "symmetry.h"
+#include "telemetry.h"
+
+//多线程搜索的并行方式
+enum class ParallelMode{
+    Tree,    //所有线程共享一棵树，用虚拟损失错开路径
+    Root     //每个线程各建一棵树，最后合并根节点各子节点的访问次数
+};
+
+//搜索树的节点池快用完时的做法
+enum class TreeFullPolicy{
+    Freeze,  //不再扩展新节点，剩下的模拟只细化已有节点的统计
+    Evict    //所有线程暂停，丢弃访问次数少的子树腾出一半空间后继续扩展
+};
+
+struct SearchConfig{
+    int threads=1;                            //搜索线程数
+    ParallelMode parallel=ParallelMode::Tree;
+    int batch=1;                              //每个线程一批推演的叶子数（最多MAX_ROLLOUT_BATCH），大于1时成批选择、推演、回传
+    bool transpositions=false;                //同一局面共用一个节点，按边统计访问次数，沿实际路径回传
+    std::size_t memory_budget=0;              //搜索树最多占用的字节数（含reroot用的备用池），0表示默认容量；根并行时其余各树再各占其1/threads
+    TreeFullPolicy when_full=TreeFullPolicy::Freeze;
+    double exploration=1.414;                 //UCB探索项的系数（开局时的值，随手数线性减小0.5）
+    RolloutPolicy rollout;                    //推演策略和棋型权重
+    bool solver=true;                         //MCTS-Solver：回传时证明胜负，选择时跳过已证明必败的子节点，候选落子都输时补全空位，根节点证明后立即停止
+    double rave=0.0;                          //RAVE的等价访问次数k：边的访问次数远少于k时主要看AMAF胜率，远多于k时主要看自身胜率；0表示不用RAVE
+};
+
+//单次搜索的预算，先达到哪一项就停止；两项都为0时按默认的模拟次数搜索
+struct SearchLimits{
+    long long playouts=0;     //模拟次数上限，0表示不限
+    double seconds=0.0;       //耗时上限（秒），0表示不限
+};
+
+//最近一次搜索的统计
+struct SearchInfo{
+    long long playouts=0;     //模拟次数
+    double seconds=0.0;       //搜索耗时（秒）
+    std::size_t tree_bytes=0; //搜索结束时搜索树实际占用的字节数
+    std::size_t evicted=0;    //搜索中因节点池快满而丢弃的节点数
+};
+
+//搜索进行中的快照，由后台的汇报线程按固定间隔生成
+struct SearchProgress{
+    int row=-1,col=-1;        //目前访问次数最多的落子，根节点尚未扩展时为-1
+    uint32_t best_visits=0;   //该落子的访问次数
+    uint32_t root_visits=0;   //根节点的访问次数
+    long long playouts=0;     //已完成的模拟次数
+    double seconds=0.0;       //已用时间（秒）
+    bool finished=false;      //搜索结束后的最后一次汇报
+};
+
+//根节点下一个候选落子的统计
+struct RootMove{
+    int row,col;
+    uint32_t visits;          //经由该落子的访问次数
+    double value;             //根节点待落子方视角的平均结果，-1到1
+};
 
+//在汇报线程上调用，不能在回调里访问GomokuGame（StopSearch除外）
+using ProgressCallback=std::function<void(const SearchProgress&)>;
 
-//重载运算符，使ChessBoard类型可以作为unordered_map的key
+//逐格比较两个棋盘，只在调试版中用于确认Zobrist键相同时局面确实相同
 bool operator==(const ChessBoard& a,const ChessBoard& b) noexcept;
 
 class GomokuGame{
 
 public:
     GomokuGame();
+    ~GomokuGame();
 
     //公共游戏接口
-    void StartGame();
+    void StartGame(bool open_center=true);         //open_center为false时从空棋盘开始，由调用者决定谁先走
     ChessBoard GetCurBoard() const noexcept;
+    uint64_t GetCurKey() const noexcept;           //当前局面的Zobrist键
+    Player GetCurPlayer() const noexcept;          //当前待落子的一方
     bool Make_Move(int row,int col,Player player);   //判断当前玩家的落子是否合法
-    std::pair <int,int> GetAIMove();   //获取AI落子位置
+    std::pair <int,int> GetAIMove();   //获取AI落子位置，AI执当前待落子的一方
+    std::pair <int,int> GetAIMove(const SearchLimits& limits);   //按给定的时间或模拟次数预算搜索
+    void StopSearch() noexcept;        //可在其他线程调用，让正在进行的搜索尽快返回目前最好的落子
+    void StartPondering();             //对手思考时在后台线程继续扩展当前局面的树
+    void StopPondering();              //停止后台搜索，已扩展的节点保留在树中
+    bool IsPondering() const noexcept;
     Player CheckWinner()noexcept;
     bool is_full()noexcept; //判断局面是否满了
+    std::size_t GetTreeSize() const noexcept;      //节点池中已分配的节点数，含复用后尚未整理回收的节点
+    double GetTreeBytesPerNode() const noexcept;   //平均每个节点占用的字节数（含子边）
+    std::size_t GetTreeBytes() const noexcept;     //搜索树实际占用的字节数，不能与搜索同时调用
+    void SetSearchConfig(const SearchConfig& config);   //设置搜索线程数和并行方式
+    SearchConfig GetSearchConfig() const noexcept;
+    SearchInfo GetSearchInfo() const noexcept;          //最近一次uctSearch的模拟次数与耗时
+    void SetProgressCallback(ProgressCallback callback,double interval=0.25);   //GetAIMove搜索期间每隔interval秒汇报一次进度，传空函数关闭
+    bool LoadOpeningBook(const std::string& path);      //映射开局库，之后GetAIMove先查库，库中有的局面立即落子
+    std::vector<RootMove> GetRootMoves();               //最近一次搜索后根节点各候选落子的统计，按访问次数从多到少
+    bool EnableSearchCache(const std::string& path,const SearchCacheOptions& options=SearchCacheOptions{});   //打开持久化的搜索缓存，新扩展的节点先取缓存中的统计，每局结束后台写回；path为空时关闭
+    MoveTelemetry GetMoveTelemetry() const noexcept;    //最近一次GetAIMove的遥测，构建时关闭遥测则全为默认值
+    bool SetTelemetryLog(const std::string& path);      //此后每次GetAIMove向path追加一行JSON遥测，path为空时关闭
 
 private:
-    ChessBoard uctSearch(const ChessBoard& board,Player player,std::pair<int,int> center);                     //利用uct算法找到AI当前棋局下最优的下一步棋盘
+    friend struct BenchmarkAccess;        //benchmark.cpp直接测量私有的热点函数
+
+    //一次搜索的停止条件，树并行时所有线程共用一个，根并行时每个线程一个
+    struct SearchControl{
+        std::atomic<long long> remaining{0};              //剩余的选择次数
+        bool timed=false;
+        std::chrono::steady_clock::time_point deadline;
+        //以下用于节点池快满时淘汰：共用这棵树的线程全部暂停后由最后一个整理
+        std::atomic<bool> evicting{false};
+        std::atomic<bool> frozen{false};                  //整理后仍然快满，不再尝试
+        std::mutex mutex;
+        std::condition_variable resumed;
+        int active=1;                                     //仍在搜索的线程数
+        int paused=0;
+        uint64_t generation=0;                            //每整理一次加1，等待的线程据此判断可以继续
+    };
+
+    std::pair<int,int> uctSearch(const ChessBoard& board,Player player,const SearchLimits& limits);   //利用uct算法找到AI当前棋局下的最优落子
+
+    std::pair<int,int> run_search(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits);   //不含启发式的MCTS部分，返回访问最多的落子
+
+    void search_worker(SearchTree& tree,const ChessBoard& board,Player player,uint64_t key,SearchControl& control);   //单个搜索线程：反复选择、模拟、反向传播，直到预算用完或被要求停止
+
+    void batch_worker(SearchTree& tree,const ChessBoard& board,Player player,uint64_t key,SearchControl& control);    //search_worker的批量版本
+
+    bool next_playout(SearchTree& tree,SearchControl& control);      //领取一次模拟的预算，预算用完、超时或被要求停止时返回false
+
+    void evict_if_full(SearchTree& tree,SearchControl& control);     //按when_full在节点池快满时会合各线程并淘汰，调用时本线程不能有未回传的路径
 
-    std::pair<ChessBoard,Player> Select(ChessBoard board,Player player,std::pair<int,int> center);  //利用MCT树的逻辑，从当前盘面向下扩展，并通过比较UCB值选择一个最佳的子节点返回
+    void leave_search(SearchTree& tree,SearchControl& control);      //线程结束搜索，其余线程都在等待淘汰时由它来做
 
-    ChessBoard expand(ChessBoard board,Player player,int x1,int x2,int y1,int y2);                        //从当前棋盘向下扩展
+    void evict(SearchTree& tree,SearchControl& control);             //持有control.mutex时调用，整理后唤醒等待的线程
 
-    double simulation_method(ChessBoard board,Player player);                    //对当前棋局进行推演，返回胜（1.0）负（-1.0）平（0.0）用于累加胜利次数
+    std::pair<int,int> root_parallel_search(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits);   //根并行：各线程独立建树后合并根节点访问次数
 
-    double UCB(const ChessBoard& board,Player player) noexcept;                   //利用statemap找到该棋盘对应的性质并计算ucb值
+    void arm(SearchControl& control,long long playouts,const SearchLimits& limits) const;   //按预算设置停止条件
 
-    void back_up(ChessBoard current,const ChessBoard& root,double value);     //通过parentmap形成的模拟链反向传播
+    std::pair<int,int> most_visited(SearchTree& tree);                      //根节点下访问次数最多的落子
 
-    void init_ChessBoard_state(const ChessBoard& board);                      //将一个新访问的棋局加入到状态列表中并对它进行初始化
+    SearchProgress progress_of(SearchTree& tree) const noexcept;            //读取根节点统计生成进度快照，可与搜索线程并发；根并行时只反映0号线程的树
 
-    void reuse(const ChessBoard& board);                                      //节点复用，无用的节点删除
+    std::pair<int,int> search_with_progress(const ChessBoard& board,Player player,uint64_t key,const SearchLimits& limits);   //run_search外加一个按间隔调用进度回调的汇报线程
 
-    std::pair<bool,std::pair<int,int>> check_four(const ChessBoard& board,Player player);   //检查四子相连
-    std::pair<bool,std::pair<int,int>> check_three(ChessBoard board,Player player);  //检查三子相连
-    std::pair<int,int> check_double_thread(const ChessBoard& board);     //检查双活三位点
+    uint32_t Select(SearchTree& tree,ChessBoard& board,Board256& stones,Player& player,uint64_t& key,SearchPath& path,uint8_t symmetries);  //利用MCT树的逻辑，从根节点向下选择，board、stones（双方棋子）、player和key随之更新为返回节点的局面、待落子方和键，经过的节点记入path；symmetries是根局面的invariant_symmetries，沿路径收窄
+
+    uint32_t expand(SearchTree& tree,uint32_t node,ChessBoard& board,Board256& stones,uint64_t& key,SearchPath& path);   //扩展节点的下一个候选落子（开启RAVE时是AMAF胜率最高的），返回子节点（开启置换时可能是已有节点），没有可扩展的落子时返回NULL_NODE
+
+    bool init_node(SearchTree& tree,uint32_t node,ChessBoard& board,const Board256& stones,uint8_t symmetries);   //生成节点的候选落子（离已有棋子两格以内的空位），按symmetries中的变换合并等价落子；开启solver时有成五点的局面只留成五或挡五的落子；board用来试落子，返回前恢复；其他线程正在生成时返回false
+
+    bool widen_node(SearchTree& tree,uint32_t node,const Board256& stones);   //候选落子全部证明必败但没覆盖所有空位时，把其余空位补进来，补全后返回true
+
+    double simulation_method(const ChessBoard& board,Player player,Board256* stones=nullptr);   //对当前棋局进行推演，返回胜（1.0）负（-1.0）平（0.0）用于累加胜利次数；stones非空时写入推演结束时双方的棋子
+
+    double exploration(double parent_visits,double edge_visits) const noexcept;      //UCB的探索项
+
+    double amaf_rate(const SearchTree& tree,uint32_t parent,int k,Player player) const noexcept;   //parent第k条边的AMAF平均结果，player视角，没有样本时为0
+
+    double unexpanded_value(const SearchTree& tree,uint32_t node,Player player) const noexcept;    //开启RAVE时尚未扩展的子边中最好的一条的ucb值：自身访问为0，胜率全取AMAF
+
+    double UCB(const SearchTree& tree,uint32_t parent,int k,uint32_t node,Player player) noexcept;     //parent第k条边指向node，根据两者的统计计算ucb值，虚拟损失计为失败；开启RAVE时胜率与边的AMAF胜率按访问次数加权
+
+    bool solve(SearchTree& tree,uint32_t node) noexcept;      //按MCTS-Solver的规则由子节点推出node的结局，负与和只在all_moves的节点上证明；node已证明时返回true
+
+    void back_up(SearchTree& tree,const SearchPath& path,double value,const Board256* stones=nullptr);     //沿选择路径反向传播，同时撤销虚拟损失，开启置换时一并更新边统计；开启solver时从叶子往上逐个尝试证明，遇到证明不了的节点为止；stones为这次模拟结束时双方的棋子，非空时更新路径上各节点子边的AMAF统计
+
+    ChessBoard frame_board() const noexcept;                  //current_board在搜索树坐标系下的样子
+    std::pair<int,int> from_frame(std::pair<int,int> move) const noexcept;   //树坐标系下的落子换回实际坐标
+
+    std::pair<int,int> decided(std::pair<int,int> move,Decision decision);   //uctSearch的出口：补全本步遥测并写日志
+
+    void merge_telemetry(const ThreadTelemetry& counters);   //搜索线程结束时合并自己的计数
+
+    void measure_tree(MoveTelemetry& record);                //遍历搜索后的树，统计节点数、分支数和置换表装载率
+
+    void record_cache();                                      //把树中访问次数够多的局面记入搜索缓存
+
+    void reuse(int row,int col,Player next,uint64_t key);                                      //节点复用，以实际落子对应的子节点为新根
+
+    //以下三个启发式直接读取威胁索引，对应current_board
+    std::pair<bool,std::pair<int,int>> check_four(Player player) const noexcept;    //检查四子相连
+    std::pair<bool,std::pair<int,int>> check_three(Player player) const noexcept;   //检查能形成活四或双冲四的位点
+    std::pair<int,int> check_double_thread() const noexcept;                        //检查双活三（含四三）位点
 
     Player check_winner(const ChessBoard& board,BitBoard b_black={},BitBoard b_white={})const noexcept;                               //检查是否有获胜者
     bool check_win_on_bitboard(const BitBoard& bitboard)const noexcept;                            //用位棋盘加速
+    bool check_win_on_bitboard(const Board256& bitboard)const noexcept;                            //整盘256位位棋盘，几次移位与按位与查完四个方向
 
     bool is_terminal(const ChessBoard& board)const noexcept;                                  //检查棋盘是否满了
 
-    std::pair <int,int> cal_center(const ChessBoard& board,BitBoard black={},BitBoard white={}) noexcept;                         //获取搜索中心
-
-    int count_piece(const ChessBoard& board,int r1,int r2,int c1,int c2)const noexcept;                               //计算给定行列范围内的棋子个数
-
     std::vector<std::vector<Diaginfo>> diag_map;
     ChessBoard current_board;
+    uint64_t current_key;          //current_board的Zobrist键，每次落子异或更新
     Player current_player;
+    Player winner;                 //current_board的胜者，由Make_Move根据最后一子更新
+    ThreatIndex threats;           //current_board上双方的成五、冲四、双三位点，随Make_Move增量更新
+    OpeningBook book;              //未加载时查库总是落空
+    SearchCache cache;             //未打开时查询总是落空，记录被忽略
     int round;
 
-    std::unordered_map<ChessBoard,StateProperty,ChessBoardHash> statemap;             //将棋盘及其相关性质一一对应
-    std::unordered_map<ChessBoard,ChessBoard,ChessBoardHash> parentmap;               //key为子节点，对应查找其父节点
+    SearchTree search_tree;                                          //MCT树，根节点始终对应current_board经frame变换后的局面
+    int frame=0;                                                     //树坐标系：树中的格子是实际格子经第frame种对称变换的像（见symmetry.h）
+    SearchConfig config;
+    SearchInfo last_info;
+    std::atomic<bool> stop_requested{false};                         //StopSearch/StopPondering置位，各搜索线程每次选择前检查
+    std::atomic<long long> playouts_done{0};                         //本次搜索实际完成的模拟次数
+    std::atomic<std::size_t> evicted_nodes{0};                       //本次搜索淘汰的节点数
+    std::mutex tree_mutex;                                           //淘汰时整理search_tree，与进度汇报线程互斥
+    std::thread ponder_thread;
+    MoveTelemetry move_telemetry;                                    //最近一次GetAIMove的遥测
+    MoveTelemetry search_telemetry;                                  //本次搜索各线程合并进来的计数，后台思考也会写入，由telemetry_mutex保护
+    std::mutex telemetry_mutex;
+    std::chrono::steady_clock::time_point decide_start;              //本次uctSearch开始的时刻
+    double reuse_seconds=0.0;                                        //上次搜索以来Make_Move复用节点的耗时，计入下一步
+    std::FILE* telemetry_log=nullptr;
+    ProgressCallback progress_callback;
+    double progress_interval=0.25;
 
     static constexpr int SELECT_NUM=100000;
     static constexpr int SIMULATION_NUM=1;
-    int select_range;
 
 };
 
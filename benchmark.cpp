@@ -0,0 +1,385 @@
+//搜索热点的基准测试，自带计时框架，不依赖第三方库
+//用法：
+//  Gomoku_bench [suite]               固定种子生成开局/中局/残局局面集，逐项计时，结果以JSON输出到标准输出
+//  Gomoku_bench scaling [最大线程数]   不同线程数下uctSearch的每秒模拟次数，输出多线程的扩展曲线
+#include "GomokuGame.h"
+#include "bitBoard.h"
+#include "board256.h"
+#include "rollout.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+//替换全局operator new以统计堆分配次数，每项结果都报告平均每次调用的分配次数
+//数组和超对齐的形式也要替换，否则它们的分配不计入，释放时还会与标准库的实现配不上对
+static std::atomic<long long> allocations{0};
+
+static void* counted_alloc(std::size_t size){
+    allocations.fetch_add(1,std::memory_order_relaxed);
+    if(void* p=std::malloc(size==0? 1:size)) return p;
+    throw std::bad_alloc();
+}
+
+static void* counted_alloc(std::size_t size,std::align_val_t align){
+    allocations.fetch_add(1,std::memory_order_relaxed);
+    std::size_t alignment=static_cast<std::size_t>(align);
+    std::size_t rounded=(size+alignment-1)/alignment*alignment;       //aligned_alloc要求大小是对齐的整数倍
+    if(void* p=std::aligned_alloc(alignment,rounded==0? alignment:rounded)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size){ return counted_alloc(size); }
+void* operator new[](std::size_t size){ return counted_alloc(size); }
+void* operator new(std::size_t size,std::align_val_t align){ return counted_alloc(size,align); }
+void* operator new[](std::size_t size,std::align_val_t align){ return counted_alloc(size,align); }
+
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete[](void* p) noexcept{ std::free(p); }
+void operator delete(void* p,std::size_t) noexcept{ std::free(p); }
+void operator delete[](void* p,std::size_t) noexcept{ std::free(p); }
+void operator delete(void* p,std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p,std::align_val_t) noexcept{ std::free(p); }
+void operator delete(void* p,std::size_t,std::align_val_t) noexcept{ std::free(p); }
+void operator delete[](void* p,std::size_t,std::align_val_t) noexcept{ std::free(p); }
+
+//GomokuGame的友元，基准测试通过它调用私有函数
+struct BenchmarkAccess{
+    static double rollout(GomokuGame& game,const ChessBoard& board,Player player){ return game.simulation_method(board,player); }
+    static Player check_winner(const GomokuGame& game,const ChessBoard& board){ return game.check_winner(board); }
+    static bool check_win_on_bitboard(const GomokuGame& game,const BitBoard& bitboard){ return game.check_win_on_bitboard(bitboard); }
+    static const std::vector<std::vector<Diaginfo>>& diag_map(const GomokuGame& game){ return game.diag_map; }
+    static const ThreatIndex& threats(const GomokuGame& game){ return game.threats; }
+
+    //uctSearch去掉根节点启发式后的MCTS部分，随机局面里几乎总有冲四活三，走启发式就测不到搜索本身
+    static std::pair<int,int> search(GomokuGame& game,const SearchLimits& limits,long long& playouts){
+        game.frame=0;
+        game.search_tree.clear(game.current_player,game.current_key);
+        std::pair<int,int> best=game.run_search(game.current_board,game.current_player,game.current_key,limits);
+        playouts=game.playouts_done.load(std::memory_order_relaxed);
+        return best;
+    }
+
+    static SearchTree& tree(GomokuGame& game){ return game.search_tree; }
+    static std::size_t evicted(const GomokuGame& game){ return game.evicted_nodes.load(std::memory_order_relaxed); }
+
+    static uint32_t select(GomokuGame& game,ChessBoard& board,Board256& stones,Player& player,uint64_t& key,SearchPath& path,uint8_t symmetries){
+        return game.Select(game.search_tree,board,stones,player,key,path,symmetries);
+    }
+    //按和棋回传，撤销虚拟损失并增加访问次数；只撤销虚拟损失的话每次都选中同一条路径，末端越扩越深，测的就不是正常搜索中的选择了
+    static void back_up(GomokuGame& game,const SearchPath& path){ game.back_up(game.search_tree,path,0.0); }
+};
+
+namespace {
+
+struct Position{
+    std::vector<std::pair<int,int>> moves;    //按落子顺序，黑先
+    ChessBoard board;
+    Player to_move;
+};
+
+struct Phase{
+    const char* name;
+    int stones;
+};
+
+const Phase PHASES[]={{"opening",6},{"middle",30},{"endgame",70}};
+constexpr int CORPUS_SIZE=16;
+constexpr uint32_t CORPUS_SEED=20240601;
+constexpr double MIN_SECONDS=0.3;           //每项至少计时这么久
+
+const char* const SIMD_NAMES[]={"scalar","avx2","avx512"};
+
+volatile double sink;                       //防止被测调用被优化掉
+
+void load(GomokuGame& game,const Position& pos){
+    game.StartGame(false);
+    Player player=Player::Black;
+    for(const auto& move : pos.moves){
+        game.Make_Move(move.first,move.second,player);
+        player=(player==Player::Black)? Player::White:Player::Black;
+    }
+}
+
+//在已有棋子附近随机落子生成局面，不允许出现五连，也不允许任何一方有成五位点（否则推演一步就结束）
+std::vector<Position> make_corpus(int stones,std::mt19937& gen){
+    std::vector<Position> corpus;
+    GomokuGame probe;
+    while(static_cast<int>(corpus.size())<CORPUS_SIZE){
+        Position pos;
+        pos.board=ChessBoard{};
+        Player player=Player::Black;
+        int tries=0;
+        while(static_cast<int>(pos.moves.size())<stones&&tries<10000){
+            tries++;
+            int r=7,c=7;
+            if(!pos.moves.empty()){
+                const auto& near=pos.moves[gen()%pos.moves.size()];
+                r=near.first+static_cast<int>(gen()%5)-2;
+                c=near.second+static_cast<int>(gen()%5)-2;
+            }
+            if(r<0||r>=BOARD_ROWS||c<0||c>=BOARD_COLS||pos.board.grid[r][c]!=Player::None) continue;
+            pos.board.grid[r][c]=player;
+            if(is_five_at(pos.board,r,c)){
+                pos.board.grid[r][c]=Player::None;
+                continue;
+            }
+            pos.moves.push_back({r,c});
+            player=(player==Player::Black)? Player::White:Player::Black;
+        }
+        if(static_cast<int>(pos.moves.size())<stones) continue;
+        pos.to_move=player;
+        load(probe,pos);
+        const ThreatIndex& threats=BenchmarkAccess::threats(probe);
+        bool quiet=true;
+        for(Player p : {Player::Black,Player::White}){
+            if(threats.win_squares(p).count()>0) quiet=false;
+        }
+        if(quiet) corpus.push_back(pos);
+    }
+    return corpus;
+}
+
+struct Result{
+    std::string name;
+    long long iterations;
+    double seconds;
+    std::string extra;        //附加的JSON字段
+    double allocs_per_op=-1.0;  //负数表示未统计
+};
+
+template<typename F>
+Result measure(const std::string& name,F&& op){
+    using clock=std::chrono::steady_clock;
+    long long iterations=0;
+    long long allocs_before=allocations.load(std::memory_order_relaxed);
+    auto start=clock::now();
+    double seconds=0.0;
+    while(seconds<MIN_SECONDS){
+        for(int i=0;i<16;i++) op(iterations++);
+        seconds=std::chrono::duration<double>(clock::now()-start).count();
+    }
+    double allocs=1.0*(allocations.load(std::memory_order_relaxed)-allocs_before)/iterations;
+    return {name,iterations,seconds,"",allocs};
+}
+
+void print_json(const std::vector<Result>& results){
+    std::printf("{\n  \"simd\": \"%s\",\n  \"benchmarks\": [\n",SIMD_NAMES[static_cast<int>(detected_simd_level())]);
+    for(std::size_t i=0;i<results.size();i++){
+        const Result& r=results[i];
+        std::string extra=r.extra;
+        if(r.allocs_per_op>=0.0) extra+=", \"allocs_per_op\": "+std::to_string(r.allocs_per_op);
+        std::printf("    {\"name\": \"%s\", \"iterations\": %lld, \"seconds\": %.6f, \"ns_per_op\": %.1f, \"ops_per_sec\": %.1f%s}%s\n",
+                    r.name.c_str(),r.iterations,r.seconds,1e9*r.seconds/r.iterations,r.iterations/r.seconds,extra.c_str(),
+                    i+1<results.size()? ",":"");
+    }
+    std::printf("  ]\n}\n");
+}
+
+int run_suite(){
+    std::mt19937 gen(CORPUS_SEED);
+    std::vector<Result> results;
+    GomokuGame game;
+    const auto& diag_map=BenchmarkAccess::diag_map(game);
+
+    for(const Phase& phase : PHASES){
+        std::vector<Position> corpus=make_corpus(phase.stones,gen);
+        std::string suffix=std::string("/")+phase.name;
+        std::vector<BitBoard> blacks(corpus.size()),whites(corpus.size());
+        for(std::size_t i=0;i<corpus.size();i++){
+            place_piece(corpus[i].board,blacks[i],whites[i],diag_map);
+        }
+
+        results.push_back(measure("place_piece"+suffix,[&](long long i){
+            BitBoard black,white;
+            place_piece(corpus[i%CORPUS_SIZE].board,black,white,diag_map);
+            sink=black.row[7]+white.row[7];
+        }));
+        results.push_back(measure("check_winner"+suffix,[&](long long i){
+            sink=static_cast<double>(BenchmarkAccess::check_winner(game,corpus[i%CORPUS_SIZE].board));
+        }));
+        results.push_back(measure("check_win_on_bitboard"+suffix,[&](long long i){
+            sink=BenchmarkAccess::check_win_on_bitboard(game,blacks[i%CORPUS_SIZE]);
+        }));
+        std::vector<Board256> wide_blacks(corpus.size()),wide_whites(corpus.size());
+        for(std::size_t i=0;i<corpus.size();i++){
+            place_piece(corpus[i].board,wide_blacks[i],wide_whites[i]);
+        }
+        results.push_back(measure("place_piece_256"+suffix,[&](long long i){
+            Board256 black,white;
+            place_piece(corpus[i%CORPUS_SIZE].board,black,white);
+            sink=static_cast<double>(black.word[1]^white.word[1]);
+        }));
+        for(SimdLevel level : {SimdLevel::Scalar,SimdLevel::AVX2,SimdLevel::AVX512}){
+            if(static_cast<int>(level)>static_cast<int>(detected_simd_level())) continue;
+            results.push_back(measure(std::string("has_five_256_")+SIMD_NAMES[static_cast<int>(level)]+suffix,[&](long long i){
+                sink=has_five(wide_blacks[i%CORPUS_SIZE],level);
+            }));
+        }
+        results.push_back(measure("rollout"+suffix,[&](long long i){
+            const Position& pos=corpus[i%CORPUS_SIZE];
+            sink=BenchmarkAccess::rollout(game,pos.board,pos.to_move);
+        }));
+
+        for(int width : {8,16}){            //批量推演，一次操作是一整批，换算成每局推演的耗时
+            ChessBoard boards[MAX_ROLLOUT_BATCH];
+            Player players[MAX_ROLLOUT_BATCH],winners[MAX_ROLLOUT_BATCH];
+            for(int k=0;k<width;k++){
+                boards[k]=corpus[k%CORPUS_SIZE].board;
+                players[k]=corpus[k%CORPUS_SIZE].to_move;
+            }
+            Result r=measure("rollout_batch"+std::to_string(width)+suffix,[&](long long){
+                rollout_batch(boards,players,width,thread_rng(),winners);
+                sink=static_cast<double>(winners[0]);
+            });
+            r.iterations*=width;
+            r.allocs_per_op/=width;
+            results.push_back(r);
+        }
+
+        //Select与reuse需要一棵已经长好的树：每个局面先搜索固定次数
+        SearchLimits grow;
+        grow.playouts=5000;
+        double select_seconds=0.0,reuse_seconds=0.0,compact_seconds=0.0;
+        long long selects=0,reuses=0;
+        std::size_t arena=0,kept=0;
+        for(int k=0;k<4;k++){
+            const Position& pos=corpus[k];
+            load(game,pos);
+            long long playouts=0;
+            std::pair<int,int> best=BenchmarkAccess::search(game,grow,playouts);
+            Board256 black,white;
+            place_piece(pos.board,black,white);
+            Board256 occupied;
+            for(int w=0;w<4;w++){
+                occupied.word[w]=black.word[w]|white.word[w];
+            }
+            uint8_t symmetries=invariant_symmetries(pos.board);     //与搜索线程一样只在根上算一次
+            Result r=measure("select",[&](long long){
+                ChessBoard board=pos.board;
+                Board256 stones=occupied;
+                Player player=pos.to_move;
+                uint64_t key=game.GetCurKey();
+                SearchPath path;
+                uint32_t leaf=BenchmarkAccess::select(game,board,stones,player,key,path,symmetries);
+                BenchmarkAccess::back_up(game,path);
+                sink=leaf;
+            });
+            select_seconds+=r.seconds;
+            selects+=r.iterations;
+            auto start=std::chrono::steady_clock::now();
+            game.Make_Move(best.first,best.second,pos.to_move);       //reuse只把子节点提升为根，不随树的大小变化
+            reuse_seconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            reuses++;
+            arena+=game.GetTreeSize();
+            start=std::chrono::steady_clock::now();
+            BenchmarkAccess::tree(game).compact();                     //池用过一半时reroot才会整理，这里单独测一次
+            compact_seconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            kept+=game.GetTreeSize();
+        }
+        results.push_back({"select"+suffix,selects,select_seconds,""});
+        results.push_back({"reuse"+suffix,reuses,reuse_seconds,", \"arena_nodes\": "+std::to_string(arena/reuses)});
+        results.push_back({"compact"+suffix,reuses,compact_seconds,", \"nodes_kept\": "+std::to_string(kept/reuses)});
+
+        //完整的一步：默认预算下的搜索耗时
+        load(game,corpus[0]);
+        long long playouts=0;
+        auto start=std::chrono::steady_clock::now();
+        BenchmarkAccess::search(game,SearchLimits{},playouts);
+        double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        results.push_back({"uct_search"+suffix,1,seconds,", \"playouts\": "+std::to_string(playouts)+", \"playouts_per_sec\": "+std::to_string(static_cast<long long>(playouts/seconds))});
+        for(int width : {8,16}){            //同样的搜索改用批量推演
+            SearchConfig config=game.GetSearchConfig();
+            config.batch=width;
+            game.SetSearchConfig(config);
+            load(game,corpus[0]);
+            start=std::chrono::steady_clock::now();
+            BenchmarkAccess::search(game,SearchLimits{},playouts);
+            seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            results.push_back({"uct_search_batch"+std::to_string(width)+suffix,1,seconds,", \"playouts\": "+std::to_string(playouts)+", \"playouts_per_sec\": "+std::to_string(static_cast<long long>(playouts/seconds))});
+            config.batch=1;
+            game.SetSearchConfig(config);
+        }
+        {                                   //同样的搜索分别按树和按置换图，比较相同模拟次数下的节点数
+            SearchConfig config=game.GetSearchConfig();
+            for(bool dag : {false,true}){
+                config.transpositions=dag;
+                game.SetSearchConfig(config);
+                load(game,corpus[0]);
+                start=std::chrono::steady_clock::now();
+                BenchmarkAccess::search(game,SearchLimits{},playouts);
+                seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+                results.push_back({std::string(dag? "uct_search_dag":"uct_search_tree")+suffix,1,seconds,", \"playouts\": "+std::to_string(playouts)+", \"playouts_per_sec\": "+std::to_string(static_cast<long long>(playouts/seconds))+", \"nodes\": "+std::to_string(game.GetTreeSize())});
+            }
+            config.transpositions=false;
+            game.SetSearchConfig(config);
+        }
+        {                                   //同样的搜索限制在2MB的树里，节点池快满时淘汰访问少的子树
+            SearchConfig config=game.GetSearchConfig();
+            config.memory_budget=2u<<20;
+            config.when_full=TreeFullPolicy::Evict;
+            game.SetSearchConfig(config);
+            load(game,corpus[0]);
+            start=std::chrono::steady_clock::now();
+            BenchmarkAccess::search(game,SearchLimits{},playouts);
+            seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+            results.push_back({"uct_search_evict"+suffix,1,seconds,", \"playouts\": "+std::to_string(playouts)+", \"playouts_per_sec\": "+std::to_string(static_cast<long long>(playouts/seconds))+
+                               ", \"tree_bytes\": "+std::to_string(game.GetTreeBytes())+", \"evicted\": "+std::to_string(BenchmarkAccess::evicted(game))});
+            config.memory_budget=0;
+            config.when_full=TreeFullPolicy::Freeze;
+            game.SetSearchConfig(config);
+        }
+    }
+    print_json(results);
+    return 0;
+}
+
+double playouts_per_second(int threads,ParallelMode mode){
+    GomokuGame game;
+    SearchConfig config;
+    config.threads=threads;
+    config.parallel=mode;
+    game.SetSearchConfig(config);
+    //固定的开局局面，避开根节点的启发式判断，保证每次都完整搜索
+    game.Make_Move(7,8,Player::White);
+    game.Make_Move(8,8,Player::Black);
+    game.Make_Move(6,6,Player::White);
+    game.GetAIMove();
+    SearchInfo info=game.GetSearchInfo();
+    return info.playouts/info.seconds;
+}
+
+int run_scaling(int max_threads){
+    std::printf("%-8s %-6s %14s %9s\n","threads","mode","playouts/s","speedup");
+    for(ParallelMode mode : {ParallelMode::Tree,ParallelMode::Root}){
+        double base=0.0;
+        for(int threads=1;threads<=max_threads;threads*=2){
+            double rate=playouts_per_second(threads,mode);
+            if(threads==1) base=rate;
+            std::printf("%-8d %-6s %14.0f %8.2fx\n",threads,mode==ParallelMode::Tree? "tree":"root",rate,rate/base);
+        }
+    }
+    return 0;
+}
+
+}
+
+int main(int argc,char* argv[]){
+    if(argc>1&&std::strcmp(argv[1],"scaling")==0){
+        int max_threads=static_cast<int>(std::thread::hardware_concurrency());
+        if(argc>2) max_threads=std::atoi(argv[2]);
+        if(max_threads<1) max_threads=1;
+        return run_scaling(max_threads);
+    }
+    if(argc>1&&std::strcmp(argv[1],"suite")!=0){
+        std::fprintf(stderr,"usage: %s [suite | scaling [max_threads]]\n",argv[0]);
+        return 1;
+    }
+    return run_suite();
+}
@@ -19,4 +19,16 @@ inline bool has_n_in_a_row(uint16_t mask,int n) noexcept{
     return x!=0;
 }
 
+inline int run_length(uint16_t mask,int p) noexcept{        //mask中包含第p位的连续1的个数（第p位须为1）
+    uint32_t m=mask;
+    int up=__builtin_ctz(~(m>>p));
+    uint32_t below=~m&((1u<<p)-1);
+    int down=(below==0)? p:p-1-(31-__builtin_clz(below));
+    return up+down;
+}
+
+//只检查经过最后一子(r,c)的四条线：新的五连只可能出现在这里，恰好五子才算胜，长连不算
+bool is_five_at(const BitBoard& bitboard,const std::vector<std::vector<Diaginfo>>& diag_map,int r,int c) noexcept;
+bool is_five_at(const ChessBoard& board,int r,int c) noexcept;        //直接在棋盘格子上沿四个方向计数，用于没有位棋盘的场合
+
 #endif // BITBOARD_H
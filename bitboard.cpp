@@ -45,6 +45,25 @@ void place_a_piece(BitBoard& black,BitBoard& white,const std::vector<std::vector
     }
 }
 
+bool is_five_at(const BitBoard& bitboard,const std::vector<std::vector<Diaginfo>>& diag_map,int r,int c) noexcept{
+    const Diaginfo& d=diag_map[r][c];
+    return run_length(bitboard.row[r],c)==5||run_length(bitboard.col[c],r)==5||
+           run_length(bitboard.diag1[d.diag1_id],d.diag1_off)==5||run_length(bitboard.diag2[d.diag2_id],d.diag2_off)==5;
+}
+
+bool is_five_at(const ChessBoard& board,int r,int c) noexcept{
+    static const int dr[4]={0,1,1,1};
+    static const int dc[4]={1,0,1,-1};
+    Player p=board.grid[r][c];
+    for(int d=0;d<4;d++){
+        int cnt=1;
+        for(int i=r+dr[d],j=c+dc[d];i>=0&&i<BOARD_ROWS&&j>=0&&j<BOARD_COLS&&board.grid[i][j]==p;i+=dr[d],j+=dc[d]) cnt++;
+        for(int i=r-dr[d],j=c-dc[d];i>=0&&i<BOARD_ROWS&&j>=0&&j<BOARD_COLS&&board.grid[i][j]==p;i-=dr[d],j-=dc[d]) cnt++;
+        if(cnt==5) return true;
+    }
+    return false;
+}
+
 void erase_a_piece(BitBoard& black,BitBoard& white,const std::vector<std::vector<Diaginfo>>& diag_map,int r,int c,Player player){
     if(player==Player::Black){
         black.row[r] &= ~(1u<<c);
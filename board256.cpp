@@ -0,0 +1,226 @@
+#include "board256.h"
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define GOMOKU_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+//求恰好五连的方法：r2=x&(x>>S)是长度≥2的连子的起点，依次得到r4、r5，
+//r5中既不是更长连子的起点（r5>>S）也不在更长连子内部（r5<<S）的位就是恰好五连的起点
+
+struct Words{
+    uint64_t w0,w1,w2,w3;
+};
+
+static inline Words operator&(Words a,Words b) noexcept{ return {a.w0&b.w0,a.w1&b.w1,a.w2&b.w2,a.w3&b.w3}; }
+static inline Words operator|(Words a,Words b) noexcept{ return {a.w0|b.w0,a.w1|b.w1,a.w2|b.w2,a.w3|b.w3}; }
+
+template<int S>
+static inline Words shr(Words x) noexcept{       //整盘右移S位（向低位），S<64
+    return {(x.w0>>S)|(x.w1<<(64-S)),(x.w1>>S)|(x.w2<<(64-S)),(x.w2>>S)|(x.w3<<(64-S)),x.w3>>S};
+}
+
+template<int S>
+static inline Words shl(Words x) noexcept{       //整盘左移S位（向高位）
+    return {x.w0<<S,(x.w1<<S)|(x.w0>>(64-S)),(x.w2<<S)|(x.w1>>(64-S)),(x.w3<<S)|(x.w2>>(64-S))};
+}
+
+template<int S>
+static inline uint64_t five_scalar(Words x) noexcept{
+    Words r2=x&shr<S>(x);
+    Words r4=r2&shr<2*S>(r2);
+    Words r5=r4&shr<S>(r4);
+    Words up=shr<S>(r5),down=shl<S>(r5);
+    return (r5.w0&~up.w0&~down.w0)|(r5.w1&~up.w1&~down.w1)|(r5.w2&~up.w2&~down.w2)|(r5.w3&~up.w3&~down.w3);
+}
+
+static bool has_five_scalar(const Board256& board) noexcept{
+    Words x={board.word[0],board.word[1],board.word[2],board.word[3]};
+    return (five_scalar<1>(x)|five_scalar<16>(x)|five_scalar<17>(x)|five_scalar<15>(x))!=0;
+}
+
+#ifdef GOMOKU_X86_DISPATCH
+
+template<int S>
+__attribute__((target("avx2"))) static inline __m256i shr_avx2(__m256i x) noexcept{
+    __m256i next=_mm256_permute4x64_epi64(x,_MM_SHUFFLE(3,3,2,1));          //[x1,x2,x3,x3]，最高一格清零
+    next=_mm256_blend_epi32(next,_mm256_setzero_si256(),0xC0);
+    return _mm256_or_si256(_mm256_srli_epi64(x,S),_mm256_slli_epi64(next,64-S));
+}
+
+template<int S>
+__attribute__((target("avx2"))) static inline __m256i shl_avx2(__m256i x) noexcept{
+    __m256i prev=_mm256_permute4x64_epi64(x,_MM_SHUFFLE(2,1,0,0));          //[x0,x0,x1,x2]，最低一格清零
+    prev=_mm256_blend_epi32(prev,_mm256_setzero_si256(),0x03);
+    return _mm256_or_si256(_mm256_slli_epi64(x,S),_mm256_srli_epi64(prev,64-S));
+}
+
+template<int S>
+__attribute__((target("avx2"))) static inline __m256i five_avx2(__m256i x) noexcept{
+    __m256i r2=_mm256_and_si256(x,shr_avx2<S>(x));
+    __m256i r4=_mm256_and_si256(r2,shr_avx2<2*S>(r2));
+    __m256i r5=_mm256_and_si256(r4,shr_avx2<S>(r4));
+    __m256i longer=_mm256_or_si256(shr_avx2<S>(r5),shl_avx2<S>(r5));
+    return _mm256_andnot_si256(longer,r5);
+}
+
+__attribute__((target("avx2"))) static bool has_five_avx2(const Board256& board) noexcept{
+    __m256i x=_mm256_load_si256(reinterpret_cast<const __m256i*>(board.word));
+    __m256i any=_mm256_or_si256(_mm256_or_si256(five_avx2<1>(x),five_avx2<16>(x)),_mm256_or_si256(five_avx2<17>(x),five_avx2<15>(x)));
+    return !_mm256_testz_si256(any,any);
+}
+
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m256i shr_avx512(__m256i x) noexcept{
+    __m256i next=_mm256_alignr_epi64(_mm256_setzero_si256(),x,1);          //[x1,x2,x3,0]
+    return _mm256_shrdi_epi64(x,next,S);
+}
+
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m256i shl_avx512(__m256i x) noexcept{
+    __m256i prev=_mm256_alignr_epi64(x,_mm256_setzero_si256(),3);          //[0,x0,x1,x2]
+    return _mm256_shldi_epi64(x,prev,S);
+}
+
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m256i five_avx512(__m256i x) noexcept{
+    __m256i r2=_mm256_and_si256(x,shr_avx512<S>(x));
+    __m256i r4=_mm256_and_si256(r2,shr_avx512<2*S>(r2));
+    __m256i r5=_mm256_and_si256(r4,shr_avx512<S>(r4));
+    return _mm256_ternarylogic_epi64(r5,shr_avx512<S>(r5),shl_avx512<S>(r5),0x10);     //r5&~up&~down
+}
+
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static bool has_five_avx512(const Board256& board) noexcept{
+    __m256i x=_mm256_load_si256(reinterpret_cast<const __m256i*>(board.word));
+    __m256i any=_mm256_or_si256(_mm256_or_si256(five_avx512<1>(x),five_avx512<16>(x)),_mm256_or_si256(five_avx512<17>(x),five_avx512<15>(x)));
+    return !_mm256_testz_si256(any,any);
+}
+
+//一个zmm寄存器放两块棋盘，低256位和高256位各一块，跨64位移位时用掩码把两块之间的那一格清零
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m512i shr_pair(__m512i x) noexcept{
+    __m512i next=_mm512_maskz_alignr_epi64(0x77,_mm512_setzero_si512(),x,1);      //[x1,x2,x3,0,x5,x6,x7,0]
+    return _mm512_shrdi_epi64(x,next,S);
+}
+
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m512i shl_pair(__m512i x) noexcept{
+    __m512i prev=_mm512_maskz_alignr_epi64(0xEE,x,_mm512_setzero_si512(),7);      //[0,x0,x1,x2,0,x4,x5,x6]
+    return _mm512_shldi_epi64(x,prev,S);
+}
+
+template<int S>
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static inline __m512i five_pair(__m512i x) noexcept{
+    __m512i r2=_mm512_and_si512(x,shr_pair<S>(x));
+    __m512i r4=_mm512_and_si512(r2,shr_pair<2*S>(r2));
+    __m512i r5=_mm512_and_si512(r4,shr_pair<S>(r4));
+    return _mm512_ternarylogic_epi64(r5,shr_pair<S>(r5),shl_pair<S>(r5),0x10);
+}
+
+__attribute__((target("avx2,avx512f,avx512vl,avx512vbmi2"))) static uint32_t has_five_many_avx512(const Board256* const* boards,int n) noexcept{
+    uint32_t mask=0;
+    int k=0;
+    for(;k+1<n;k+=2){
+        //两块棋盘各放进零向量的一半；cast和zext在GCC里都经非掩码的inserti64x4实现，以未定义的向量作直通值，会报未初始化，改用全掩码的形式
+        const __m512i zero=_mm512_setzero_si512();
+        __m512i x=_mm512_mask_inserti64x4(zero,0xFF,zero,_mm256_load_si256(reinterpret_cast<const __m256i*>(boards[k]->word)),0);
+        x=_mm512_mask_inserti64x4(x,0xFF,x,_mm256_load_si256(reinterpret_cast<const __m256i*>(boards[k+1]->word)),1);
+        __m512i any=_mm512_or_si512(_mm512_or_si512(five_pair<1>(x),five_pair<16>(x)),_mm512_or_si512(five_pair<17>(x),five_pair<15>(x)));
+        __mmask8 lanes=_mm512_test_epi64_mask(any,any);
+        if(lanes&0x0F) mask|=1u<<k;
+        if(lanes&0xF0) mask|=1u<<(k+1);
+    }
+    if(k<n&&has_five_avx512(*boards[k])) mask|=1u<<k;
+    return mask;
+}
+
+#endif
+
+static SimdLevel detect() noexcept{
+#ifdef GOMOKU_X86_DISPATCH
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512vl")&&__builtin_cpu_supports("avx512vbmi2")) return SimdLevel::AVX512;
+    if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+using FiveFn=bool(*)(const Board256&) noexcept;
+
+static FiveFn implementation(SimdLevel level) noexcept{
+#ifdef GOMOKU_X86_DISPATCH
+    if(level==SimdLevel::AVX512) return has_five_avx512;
+    if(level==SimdLevel::AVX2) return has_five_avx2;
+#endif
+    (void)level;
+    return has_five_scalar;
+}
+
+//检测结果放在函数内的静态变量里，其他翻译单元的静态初始化中调用也安全
+struct Dispatch{
+    SimdLevel level;
+    FiveFn five;
+};
+
+static const Dispatch& dispatch() noexcept{
+    static const Dispatch d{detect(),implementation(detect())};
+    return d;
+}
+
+SimdLevel detected_simd_level() noexcept{
+    return dispatch().level;
+}
+
+bool has_five(const Board256& board) noexcept{
+    return dispatch().five(board);
+}
+
+uint32_t has_five_many(const Board256* const* boards,int n) noexcept{
+#ifdef GOMOKU_X86_DISPATCH
+    if(dispatch().level==SimdLevel::AVX512) return has_five_many_avx512(boards,n);
+#endif
+    FiveFn five=dispatch().five;
+    uint32_t mask=0;
+    for(int k=0;k<n;k++){
+        if(five(*boards[k])) mask|=1u<<k;
+    }
+    return mask;
+}
+
+bool has_five(const Board256& board,SimdLevel level) noexcept{
+    if(static_cast<int>(level)>static_cast<int>(dispatch().level)) level=dispatch().level;
+    return implementation(level)(board);
+}
+
+void place_piece(const ChessBoard& board,Board256& black,Board256& white) noexcept{
+    black=Board256{};
+    white=Board256{};
+    for(int i=0;i<BOARD_ROWS;i++){
+        for(int j=0;j<BOARD_COLS;j++){
+            if(board.grid[i][j]==Player::Black) black.set(i,j);
+            else if(board.grid[i][j]==Player::White) white.set(i,j);
+        }
+    }
+}
+
+static constexpr Words ON_BOARD={0x7FFF7FFF7FFF7FFFull,0x7FFF7FFF7FFF7FFFull,0x7FFF7FFF7FFF7FFFull,0x00007FFF7FFF7FFFull};   //15×15个格子所在的位
+
+Board256 dilate(const Board256& cells) noexcept{
+    Words x={cells.word[0],cells.word[1],cells.word[2],cells.word[3]};
+    Words h=(shl<1>(x)|shr<1>(x)|x)&ON_BOARD;       //先横向扩一格，越过行首行尾的位落在保护列上，随即清掉
+    Words v=(shl<16>(h)|shr<16>(h)|h)&ON_BOARD;
+    return Board256{{v.w0,v.w1,v.w2,v.w3}};
+}
+
+template<int S>
+static inline Words two_steps(Words x) noexcept{      //每走一步都清掉保护列，第二步才不会从行尾绕到下一行
+    Words up=shl<S>(shl<S>(x)&ON_BOARD)&ON_BOARD;
+    Words down=shr<S>(shr<S>(x)&ON_BOARD)&ON_BOARD;
+    return up|down;
+}
+
+Board256 reach2(const Board256& cells) noexcept{
+    Words x={cells.word[0],cells.word[1],cells.word[2],cells.word[3]};
+    Words r=two_steps<1>(x)|two_steps<16>(x)|two_steps<17>(x)|two_steps<15>(x);
+    return Board256{{r.w0,r.w1,r.w2,r.w3}};
+}
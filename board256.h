@@ -0,0 +1,37 @@
+#ifndef BOARD256_H
+#define BOARD256_H
+
+#include "config.h"
+#include <cstdint>
+
+//整盘256位位棋盘：每种颜色一块，每行占16位（15列加1位恒为0的保护列），15行共240位，放在4个uint64里
+//第r行第c列对应第r*16+c位。四个方向的相邻格分别相差1（横）、16（竖）、17（主对角）、15（副对角）位，
+//保护列保证横向和斜向移位不会从一行的末尾绕到下一行的开头，所以五连检测就是整盘的几次移位与按位与
+struct alignas(32) Board256{
+    uint64_t word[4]={0,0,0,0};
+
+    void set(int r,int c) noexcept{ word[r>>2]|=1ull<<(((r&3)<<4)+c); }
+    void reset(int r,int c) noexcept{ word[r>>2]&=~(1ull<<(((r&3)<<4)+c)); }
+    bool test(int r,int c) const noexcept{ return (word[r>>2]>>(((r&3)<<4)+c))&1ull; }
+    bool empty() const noexcept{ return (word[0]|word[1]|word[2]|word[3])==0; }
+};
+
+enum class SimdLevel{
+    Scalar,     //可移植的4×uint64实现
+    AVX2,       //一个ymm寄存器，跨64位的移位用permute拼接
+    AVX512      //AVX-512VL+VBMI2，跨64位的移位用valignq和双精度移位指令
+};
+
+SimdLevel detected_simd_level() noexcept;      //运行时检测到的最高可用级别，has_five默认使用它
+
+//棋盘上是否有恰好五连（长连不算），四个方向一起检查
+bool has_five(const Board256& board) noexcept;
+bool has_five(const Board256& board,SimdLevel level) noexcept;   //指定实现，CPU不支持时退回标量版，供测试和基准对比
+uint32_t has_five_many(const Board256* const* boards,int n) noexcept;   //同时检查n（不超过32）块棋盘，第k位为1表示boards[k]有五连；AVX-512下一次检查两块
+
+void place_piece(const ChessBoard& board,Board256& black,Board256& white) noexcept;
+
+Board256 dilate(const Board256& cells) noexcept;     //每个格子连同周围八格，保护列和第15行以后的位保持为0
+Board256 reach2(const Board256& cells) noexcept;     //从每个格子沿横、竖、两条斜线向两侧各走两格到达的格子
+
+#endif // BOARD256_H
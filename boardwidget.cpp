@@ -1,19 +1,44 @@
 #include "BoardWidget.h"
 #include <QPainter>
-#include <QApplication>
 #include <QDebug>
+#include <QThread>
+#include <QCoreApplication>
+#include <QDir>
+#include <QStandardPaths>
 
 BoardWidget::BoardWidget(QWidget *parent)
-    : QWidget(parent), m_gameInProgress(false), m_isHumanTurn(false){
+    : QWidget(parent), m_discardAIMove(false), m_gameInProgress(false), m_isHumanTurn(false){
 
     setMinimumSize(400,400);  // 设置一个合理的最小尺寸，防止窗口缩得太小
 
+    SearchConfig config;
+    config.threads=QThread::idealThreadCount();   // AI思考时用满所有核心
+    m_game.SetSearchConfig(config);
+    m_game.LoadOpeningBook(QCoreApplication::applicationDirPath().toStdString()+"/"+DEFAULT_BOOK_FILE);   // 没有开局库时照常搜索
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    if(!dataDir.isEmpty() && QDir().mkpath(dataDir)){
+        m_game.EnableSearchCache(QDir(dataDir).filePath(DEFAULT_CACHE_FILE).toStdString());   // 搜索缓存跨局保留，越下越快
+    }
+
+    // 进度回调在引擎的汇报线程上执行，只发信号，不碰任何界面对象
+    m_game.SetProgressCallback([this](const SearchProgress &p){
+        emit aiProgress(p.row, p.col, p.best_visits, p.root_visits, p.playouts, p.seconds);
+    }, 0.2);
+    connect(this, &BoardWidget::aiMoveReady, this, &BoardWidget::onAIMoveReady, Qt::QueuedConnection);
+    connect(this, &BoardWidget::aiProgress, this, &BoardWidget::onAIProgress, Qt::QueuedConnection);
+
     updateDimensions();   // 立即计算一次绘制参数
 }
 
+BoardWidget::~BoardWidget(){
+    stopAITurn();   // 先停下思考线程，再析构m_game
+}
+
 void BoardWidget::startGame(){
     qDebug()<<"Starting new game...";
+    stopAITurn();  // AI还在思考时开新局，旧的搜索作废
     m_game.StartGame(); // 逻辑核心，重置棋盘
+    m_board = m_game.GetCurBoard();
     m_gameInProgress = true;
     m_isHumanTurn = true; // AI(黑棋)先手在天元，所以轮到玩家(白棋)
     update();   // update不会立刻调用 paintEvent，而是让Qt在下一个事件循环周期去调用，这比repaint(立刻重绘)更高效
@@ -64,7 +89,7 @@ void BoardWidget::paintEvent(QPaintEvent *event){
                          m_offsetX+(BOARD_ROWS-1)*m_gridSize, m_offsetY+i*m_gridSize);
     }
 
-    ChessBoard board=m_game.GetCurBoard(); // 从游戏逻辑中获取当前棋盘状态
+    const ChessBoard &board=m_board; // AI思考时m_game归思考线程，这里只画界面线程的副本
     for (int r=0;r<BOARD_ROWS;r++) {
         for (int c=0;c<BOARD_COLS;c++) {
             Player p=board.grid[r][c];
@@ -110,6 +135,7 @@ void BoardWidget::mousePressEvent(QMouseEvent *event){
 
 void BoardWidget::processHumanMove(int row, int col){
     if (m_game.Make_Move(row, col, Player::White)) {
+        m_board = m_game.GetCurBoard();
         m_isHumanTurn = false; // 换AI落子
         update(); // 重绘棋盘，显示玩家的棋子
 
@@ -118,20 +144,65 @@ void BoardWidget::processHumanMove(int row, int col){
             endGame(winner); // 游戏结束
             return;
         }
-        QApplication::processEvents();
 
-        processAITurn();
+        startAITurn();
 
     } else {
         qDebug()<<"Invalid move at"<<row<<","<<col;   //无效落子
     }
 }
 
-void BoardWidget::processAITurn(){
-    std::pair<int, int> aiMove = m_game.GetAIMove();
-    qDebug()<<"AI moved at [row, col]:"<<aiMove.first<<","<<aiMove.second;
+void BoardWidget::startAITurn(){
+    emit statusMessage(tr("AI is thinking..."));
+    // 思考线程独占m_game直到发出aiMoveReady，界面线程在此期间只读m_board
+    m_aiThread = std::thread([this]{
+        std::pair<int, int> aiMove = m_game.GetAIMove();
+        emit aiMoveReady(aiMove.first, aiMove.second);
+    });
+}
+
+void BoardWidget::stopAITurn(){
+    if (!m_aiThread.joinable()) {
+        return;
+    }
+    m_game.StopSearch();   // StopSearch可以跨线程调用，搜索很快返回
+    m_aiThread.join();
+    m_discardAIMove = true; // 每次思考恰好发出一个aiMoveReady，已在队列中的那个到达时丢弃
+}
 
-    m_game.Make_Move(aiMove.first, aiMove.second, Player::Black);
+void BoardWidget::moveNow(){
+    if (m_aiThread.joinable()) {
+        m_game.StopSearch();   // 搜索返回目前访问最多的落子，照常经aiMoveReady送回
+    }
+}
+
+void BoardWidget::onAIProgress(int row, int col, quint32 bestVisits, quint32 rootVisits, qint64 playouts, double seconds){
+    if (!m_aiThread.joinable() || row < 0) {
+        return;   // 已取消的搜索或根节点还没有子节点
+    }
+    double rate = seconds > 0 ? playouts / seconds : 0.0;
+    double share = rootVisits > 0 ? 100.0 * bestVisits / rootVisits : 0.0;
+    emit statusMessage(tr("AI thinking: best (%1, %2)  visits %3 (%4%)  %5 playouts  %6 playouts/s")
+                           .arg(row).arg(col).arg(bestVisits).arg(share, 0, 'f', 1)
+                           .arg(playouts).arg(rate, 0, 'f', 0));
+}
+
+void BoardWidget::onAIMoveReady(int row, int col){
+    if (m_discardAIMove) {
+        m_discardAIMove = false;
+        return;
+    }
+    m_aiThread.join();   // 线程已经发出信号，马上结束；之后m_game重新归界面线程
+    SearchInfo info = m_game.GetSearchInfo();
+    qDebug()<<"AI moved at [row, col]:"<<row<<","<<col;
+    qDebug()<<"Search tree nodes:"<<m_game.GetTreeSize()<<"bytes per node:"<<m_game.GetTreeBytesPerNode();
+    MoveTelemetry telemetry = m_game.GetMoveTelemetry();   // 构建时关闭遥测则只有默认值
+    qDebug()<<"Decision:"<<decision_name(telemetry.decision)<<"depth max/avg:"<<telemetry.max_depth<<telemetry.average_depth()
+            <<"branching max/avg:"<<telemetry.max_branching<<telemetry.average_branching();
+    emit statusMessage(tr("AI moved at (%1, %2) after %3 playouts in %4 s").arg(row).arg(col).arg(info.playouts).arg(info.seconds, 0, 'f', 2));
+
+    m_game.Make_Move(row, col, Player::Black);
+    m_board = m_game.GetCurBoard();
     update(); // 重绘棋盘，显示AI的棋子
 
     Player winner = m_game.CheckWinner();
@@ -146,6 +217,7 @@ void BoardWidget::processAITurn(){
     }
 
     m_isHumanTurn = true;
+    m_game.StartPondering();   // 玩家思考期间后台继续搜索，玩家落子时Make_Move会停下并保留对应子树
 
 }
 
@@ -155,12 +227,14 @@ void BoardWidget::endGame(Player winner)
     m_isHumanTurn = false;  // 谁的回合都不重要了
     if(winner==Player::Black){
         qDebug()<<"AI wins";
+        emit statusMessage(tr("AI wins"));
     }
     else if(winner==Player::White){
         qDebug()<<"Human wins";
+        emit statusMessage(tr("Human wins"));
     }
     else{
         qDebug()<<"No player win";
+        emit statusMessage(tr("Draw"));
     }
 }
-
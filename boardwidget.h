@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QMouseEvent>
+#include <thread>
 #include "GomokuGame.h"
 
 class BoardWidget : public QWidget{
@@ -10,21 +11,36 @@ class BoardWidget : public QWidget{
 
 public:
     explicit BoardWidget(QWidget *parent = nullptr);   // 防止隐式转换
+    ~BoardWidget() override;
+
+    bool isThinking() const { return m_aiThread.joinable(); }
 
 signals:
+    // 以下信号由AI思考线程发出，连接为排队方式，槽函数总在界面线程执行
+    void aiMoveReady(int row, int col);
+    void aiProgress(int row, int col, quint32 bestVisits, quint32 rootVisits, qint64 playouts, double seconds);
 
+    void statusMessage(const QString &text);   // 供主窗口状态栏显示的提示
 
     // “槽”：一种特殊的“函数”，可以“接收”来自其他控件的“信号”
 public slots:
     void startGame();
+    void moveNow();          // 让AI立即停止搜索，下目前最好的一步
 
 protected:
     void paintEvent(QPaintEvent *event) override;    // 当Qt系统认为“这个控件该重绘了” (比如窗口缩放或被遮挡后)，就会自动调用这个函数
 
     void mousePressEvent(QMouseEvent *event) override;   // 当用户在这个控件上“按下鼠标”时，就会自动调用这个函数
 
+private slots:
+    void onAIMoveReady(int row, int col);
+    void onAIProgress(int row, int col, quint32 bestVisits, quint32 rootVisits, qint64 playouts, double seconds);
+
 private:
-    GomokuGame m_game; // 每个棋盘控件都有一个游戏逻辑实例
+    GomokuGame m_game; // 每个棋盘控件都有一个游戏逻辑实例，AI思考期间只归思考线程使用
+    ChessBoard m_board; // 界面线程自己的棋盘副本，绘制时不读m_game
+    std::thread m_aiThread; // AI思考线程，思考结束后由onAIMoveReady回收
+    bool m_discardAIMove; // 新开一局时正在进行的搜索结果作废
     bool m_gameInProgress; // 判断游戏是否正在进行
     bool m_isHumanTurn;  // 判断当前是否轮到玩家落子，防止AI思考时玩家乱点
 
@@ -38,7 +54,9 @@ private:
 
     void processHumanMove(int row, int col);    // 处理玩家落子后的所有逻辑
 
-    void processAITurn();     // 处理AI落子后的所有逻辑
+    void startAITurn();       // 在后台线程开始AI思考，界面保持响应
+
+    void stopAITurn();        // 停止并回收思考线程，丢弃它的结果
 
     void endGame(Player winner);    // 游戏结束时的处理
 };
@@ -0,0 +1,176 @@
+//开局库生成器：从空棋盘和天元开局出发逐层搜索，每个局面记下搜索的最佳落子，不依赖Qt
+//用法：
+//  Gomoku_book 输出文件 [--in 已有开局库] [--depth 层数] [--width 分支数] [--playouts 模拟次数] [--threads 线程数]
+//每层的局面分给所有线程并行搜索，每个线程持有自己的GomokuGame；每层结束都写一次文件，中断后可用--in接着扩充
+//已在库中的局面不再搜索，只沿库中的落子继续向下
+#include "GomokuGame.h"
+#include "openingBook.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Options{
+    std::string out;
+    std::string in;
+    int depth=6;                  //从起始局面向下展开的层数
+    int width=2;                  //每个局面向下展开的候选落子数
+    long long playouts=400000;    //每个局面的搜索预算
+    double min_share=0.25;        //访问次数不到最佳落子这个比例的候选不展开
+    int threads=static_cast<int>(std::max(1u,std::thread::hardware_concurrency()));
+};
+
+using Line=std::vector<std::pair<int,int>>;     //从空棋盘开始的落子序列，黑先
+
+Player side_to_move(const Line& line){
+    return (line.size()%2==0)? Player::Black:Player::White;
+}
+
+ChessBoard board_of(const Line& line){
+    ChessBoard board;
+    for(std::size_t i=0;i<line.size();i++){
+        board.grid[line[i].first][line[i].second]=(i%2==0)? Player::Black:Player::White;
+    }
+    return board;
+}
+
+void load(GomokuGame& game,const Line& line){
+    game.StartGame(false);
+    for(std::size_t i=0;i<line.size();i++){
+        game.Make_Move(line[i].first,line[i].second,(i%2==0)? Player::Black:Player::White);
+    }
+}
+
+bool parse(int argc,char* argv[],Options& options){
+    if(argc<2) return false;
+    options.out=argv[1];
+    for(int i=2;i+1<argc;i+=2){
+        if(std::strcmp(argv[i],"--in")==0) options.in=argv[i+1];
+        else if(std::strcmp(argv[i],"--depth")==0) options.depth=std::atoi(argv[i+1]);
+        else if(std::strcmp(argv[i],"--width")==0) options.width=std::atoi(argv[i+1]);
+        else if(std::strcmp(argv[i],"--playouts")==0) options.playouts=std::atoll(argv[i+1]);
+        else if(std::strcmp(argv[i],"--threads")==0) options.threads=std::atoi(argv[i+1]);
+        else if(std::strcmp(argv[i],"--min-share")==0) options.min_share=std::atof(argv[i+1]);
+        else return false;
+    }
+    return options.depth>0&&options.width>0&&options.playouts>0&&options.threads>0;
+}
+
+}
+
+int main(int argc,char* argv[]){
+    Options options;
+    if(!parse(argc,argv,options)){
+        std::fprintf(stderr,"usage: %s out.book [--in book] [--depth N] [--width N] [--playouts N] [--threads N] [--min-share F]\n",argv[0]);
+        return 2;
+    }
+
+    std::unordered_map<uint64_t,BookEntry> book;
+    if(!options.in.empty()){
+        OpeningBook existing;
+        if(!existing.Open(options.in)){
+            std::fprintf(stderr,"cannot open book %s\n",options.in.c_str());
+            return 1;
+        }
+        for(const BookEntry& entry : existing.Entries()){
+            book[entry.key]=entry;
+        }
+        std::fprintf(stderr,"loaded %zu positions from %s\n",book.size(),options.in.c_str());
+    }
+
+    std::vector<Line> frontier={{},{{BOARD_ROWS/2,BOARD_COLS/2}}};      //空棋盘（命令行引擎执黑）和天元开局（界面）
+    for(int level=0;level<options.depth&&!frontier.empty();level++){
+        std::vector<std::vector<Line>> children(frontier.size());
+        std::atomic<std::size_t> next{0};
+        std::mutex book_mutex;
+        auto worker=[&]{
+            GomokuGame game;          //每个线程一局，单线程搜索，并行度来自同时搜索多个局面
+            while(true){
+                std::size_t i=next.fetch_add(1);
+                if(i>=frontier.size()) break;
+                const Line& line=frontier[i];
+                ChessBoard board=board_of(line);
+                Player player=side_to_move(line);
+                int transform;
+                uint64_t key=OpeningBook::CanonicalKey(board,player,transform);
+                {
+                    std::lock_guard<std::mutex> lock(book_mutex);
+                    auto found=book.find(key);
+                    if(found!=book.end()){
+                        int cell=transform_cell(found->second.move,inverse_symmetry(transform));
+                        Line child=line;
+                        child.push_back({cell/BOARD_COLS,cell%BOARD_COLS});
+                        children[i].push_back(child);
+                        continue;
+                    }
+                }
+                load(game,line);
+                if(game.CheckWinner()!=Player::None||game.is_full()) continue;
+                SearchLimits limits;
+                limits.playouts=options.playouts;
+                std::pair<int,int> best=game.GetAIMove(limits);
+                if(best.first<0) continue;
+                std::vector<RootMove> moves=game.GetRootMoves();
+                BookEntry entry{key,0,0,static_cast<uint8_t>(transform_cell(best.first*BOARD_COLS+best.second,transform)),static_cast<uint8_t>(line.size())};
+                for(const RootMove& move : moves){
+                    if(move.row==best.first&&move.col==best.second){
+                        entry.visits=move.visits;
+                        entry.value=static_cast<int16_t>(std::lround(move.value*10000.0));
+                    }
+                }
+                children[i].push_back(line);
+                children[i].back().push_back(best);     //启发式给出的落子不在统计里，也要展开
+                for(const RootMove& move : moves){
+                    if(static_cast<int>(children[i].size())>=options.width) break;
+                    if(move.row==best.first&&move.col==best.second) continue;
+                    if(moves.front().visits==0||move.visits<options.min_share*moves.front().visits) break;
+                    children[i].push_back(line);
+                    children[i].back().push_back({move.row,move.col});
+                }
+                std::lock_guard<std::mutex> lock(book_mutex);
+                book[key]=entry;
+            }
+        };
+        std::vector<std::thread> workers;
+        for(int t=0;t<options.threads;t++){
+            workers.emplace_back(worker);
+        }
+        for(auto& thread : workers){
+            thread.join();
+        }
+
+        std::vector<BookEntry> entries;
+        entries.reserve(book.size());
+        for(const auto& item : book){
+            entries.push_back(item.second);
+        }
+        if(!OpeningBook::Write(options.out,entries)){
+            std::fprintf(stderr,"cannot write %s\n",options.out.c_str());
+            return 1;
+        }
+        std::fprintf(stderr,"level %d: %zu positions searched or reused, book has %zu positions\n",level,frontier.size(),entries.size());
+
+        //下一层：对称等价的局面只保留一个
+        std::vector<Line> next_frontier;
+        std::unordered_set<uint64_t> seen;
+        for(const auto& group : children){
+            for(const Line& child : group){
+                int transform;
+                if(seen.insert(OpeningBook::CanonicalKey(board_of(child),side_to_move(child),transform)).second) next_frontier.push_back(child);
+            }
+        }
+        frontier.swap(next_frontier);
+    }
+    return 0;
+}
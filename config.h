@@ -1,6 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 
@@ -18,11 +19,37 @@ struct ChessBoard{
     Player grid[BOARD_ROWS][BOARD_COLS]={};   //所有格子初始化为None
 };
 
-//用于记录节点的性质
-struct StateProperty{
-    double win=0.0;   //胜利次数
-    double visit=0.0;    //访问次数
-    std::vector <ChessBoard> children;   //用来记录每个节点推演出来的子棋局
+constexpr uint32_t NULL_NODE=0xFFFFFFFFu;   //空节点下标
+constexpr uint8_t NO_MOVE=0xFF;            //根节点没有对应的落子
+
+//局面在双方都走最好时的结局。终局节点创建时即确定，其余由MCTS-Solver在回传时从子节点推出：
+//有一个子节点是待落子方胜，该局面就是待落子方胜；候选落子覆盖了所有要紧的落子（TreeNode::all_moves）、
+//全部扩展且都已证明时，取其中对待落子方最好的，所以待落子方负或和只在这种节点上证明
+enum class Proof:uint8_t{
+    Unknown=0,
+    BlackWins,
+    WhiteWins,
+    Draw        //棋盘下满且无人成五
+};
+
+inline Proof win_for(Player player) noexcept{ return (player==Player::Black)? Proof::BlackWins:Proof::WhiteWins; }
+
+//MCT树节点，存放在SearchTree的连续节点池中，通过32位下标互相引用
+//统计量都是原子变量，多个搜索线程共享同一棵树时无需加锁
+struct TreeNode{
+    std::atomic<int32_t> win{0};            //胜负累计（黑胜+1，白胜-1）
+    std::atomic<uint32_t> visit{0};         //访问次数
+    std::atomic<uint32_t> virtual_loss{0};  //正在经过该节点的模拟数，计为落子方的失败，避免多个线程挤在同一路径上
+    uint32_t parent=NULL_NODE;              //父节点下标
+    std::atomic<uint32_t> edge_begin{0};    //子边在边池中的起始下标
+    std::atomic<uint16_t> expanded{0};      //已领取的子边数，前expanded条边依次扩展出子节点
+    std::atomic<uint8_t> edge_num{0};       //候选落子数；它和edge_begin在补全候选落子时会被改写，见SearchTree::widen_edges
+    uint8_t move=NO_MOVE;                   //到达该节点的落子，row*BOARD_COLS+col
+    Player player=Player::None;             //该局面下轮到落子的一方
+    std::atomic<Proof> proof{Proof::Unknown};   //已证明的结局；到达该节点的落子连成五子时创建即为胜，已证明的节点不再向下搜索
+    std::atomic<uint8_t> state{0};          //候选落子的生成状态，见SearchTree::EDGES_*
+    std::atomic<uint8_t> picking{0};        //开启RAVE时扩展线程挑选下一个落子的自旋锁，占用原有的对齐填充；补全候选落子时也要持有
+    std::atomic<bool> all_moves{false};     //候选落子覆盖了所有要紧的落子：有成五点时的成五或挡五，或者全部空位；MCTS-Solver只在这种节点上证明负与和
 };
 
 struct BitBoard{
@@ -38,21 +65,43 @@ struct Diaginfo{               //记录对角线的下标以及相应位点下
     int diag2_id,diag2_off;
 };
 
-struct ChessBoardHash {                       //为每个棋盘计算hash值
-    std::size_t operator()(const ChessBoard& board) const noexcept {       //重载（）
-        std::size_t h=0;
-        const std::size_t prime=1099511628211ULL;
-        const std::size_t offset=1469598103934665603ULL;
-
-        h=offset;
-        for(int i=0;i<BOARD_ROWS;i++) {
-            for (int j=0;j<BOARD_COLS;j++) {
-                h^=static_cast<std::size_t>(board.grid[i][j]);
-                h*=prime;
+//Zobrist哈希：每个格子、每种颜色一个64位随机数，局面的键为所有棋子对应随机数的异或
+//落子或提子时只需异或一次即可增量更新，随机数在编译期由splitmix64生成
+struct ZobristTable{
+    uint64_t key[BOARD_ROWS*BOARD_COLS][2]={};
+};
+
+constexpr ZobristTable make_zobrist_table(){
+    ZobristTable table{};
+    uint64_t state=0x9E3779B97F4A7C15ULL;
+    for(int i=0;i<BOARD_ROWS*BOARD_COLS;i++){
+        for(int k=0;k<2;k++){
+            state+=0x9E3779B97F4A7C15ULL;
+            uint64_t z=state;
+            z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+            z=(z^(z>>27))*0x94D049BB133111EBULL;
+            table.key[i][k]=z^(z>>31);
+        }
+    }
+    return table;
+}
+
+inline constexpr ZobristTable ZOBRIST=make_zobrist_table();
+
+inline uint64_t zobrist_of(int r,int c,Player player) noexcept{         //(r,c)处player棋子对应的随机数
+    return ZOBRIST.key[r*BOARD_COLS+c][static_cast<int>(player)-1];
+}
+
+inline uint64_t zobrist_key(const ChessBoard& board) noexcept{          //完整计算一次局面的键，只在建立根节点等少数场合使用
+    uint64_t h=0;
+    for(int i=0;i<BOARD_ROWS;i++){
+        for(int j=0;j<BOARD_COLS;j++){
+            if(board.grid[i][j]!=Player::None){
+                h^=zobrist_of(i,j,board.grid[i][j]);
             }
         }
-        return h;
     }
-};
+    return h;
+}
 
 #endif // CONFIG_H
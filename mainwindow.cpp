@@ -1,6 +1,8 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include <QVBoxLayout>
+#include <QMenu>
+#include <QAction>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -13,6 +15,19 @@ MainWindow::MainWindow(QWidget *parent)
     boardLayout->addWidget(m_board); // 把棋盘控件添加到布局中
     boardLayout->setContentsMargins(0, 0, 0, 0);   //边距设为0让棋盘填满容器
 
+    // AI在后台线程思考，界面线程可以随时开新局或让AI立即落子
+    QMenu *gameMenu = ui->menubar->addMenu(tr("&Game"));
+    QAction *newGame = gameMenu->addAction(tr("&New Game"));
+    newGame->setShortcut(QKeySequence::New);
+    connect(newGame, &QAction::triggered, m_board, &BoardWidget::startGame);
+    QAction *moveNow = gameMenu->addAction(tr("&Move Now"));
+    moveNow->setShortcut(Qt::Key_Space);
+    connect(moveNow, &QAction::triggered, m_board, &BoardWidget::moveNow);
+
+    connect(m_board, &BoardWidget::statusMessage, ui->statusbar, [this](const QString &text){
+        ui->statusbar->showMessage(text);
+    });
+
     m_board->startGame();   //启动时自动开始一局新游戏
 }
 
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+//只读映射整个文件，开局库和搜索缓存共用；映射期间其他进程可以用改名的方式替换文件
+class MappedFile{
+
+public:
+    MappedFile()=default;
+    ~MappedFile();
+    MappedFile(const MappedFile&)=delete;
+    MappedFile& operator=(const MappedFile&)=delete;
+
+    bool Open(const std::string& path);        //文件不存在、为空或映射失败时返回false并保持未打开
+    void Close() noexcept;
+    bool IsOpen() const noexcept{ return mapping!=nullptr; }
+    const void* Data() const noexcept{ return mapping; }
+    std::size_t Size() const noexcept{ return mapped_bytes; }
+
+    static bool Replace(const std::string& temp,const std::string& path);   //把写好的临时文件改名为path，覆盖旧文件
+
+private:
+    void* mapping=nullptr;
+    std::size_t mapped_bytes=0;
+#ifdef _WIN32
+    void* file_handle=nullptr;
+    void* map_handle=nullptr;
+#endif
+
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,78 @@
+#include "mappedFile.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile(){
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path){
+    Close();
+#ifdef _WIN32
+    HANDLE file=CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_DELETE,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+    if(file==INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file,&size)||size.QuadPart==0){
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE map=CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+    void* data=map? MapViewOfFile(map,FILE_MAP_READ,0,0,0):nullptr;
+    if(data==nullptr){
+        if(map) CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+    file_handle=file;
+    map_handle=map;
+    mapping=data;
+    mapped_bytes=static_cast<std::size_t>(size.QuadPart);
+#else
+    int fd=::open(path.c_str(),O_RDONLY);
+    if(fd<0) return false;
+    struct stat st;
+    if(fstat(fd,&st)!=0||st.st_size==0){
+        ::close(fd);
+        return false;
+    }
+    void* data=mmap(nullptr,static_cast<std::size_t>(st.st_size),PROT_READ,MAP_SHARED,fd,0);
+    ::close(fd);            //映射建立后文件描述符就不需要了
+    if(data==MAP_FAILED) return false;
+    mapping=data;
+    mapped_bytes=static_cast<std::size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close() noexcept{
+    if(mapping!=nullptr){
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(static_cast<HANDLE>(map_handle));
+        CloseHandle(static_cast<HANDLE>(file_handle));
+        map_handle=nullptr;
+        file_handle=nullptr;
+#else
+        munmap(mapping,mapped_bytes);
+#endif
+    }
+    mapping=nullptr;
+    mapped_bytes=0;
+}
+
+bool MappedFile::Replace(const std::string& temp,const std::string& path){
+#ifdef _WIN32
+    return MoveFileExA(temp.c_str(),path.c_str(),MOVEFILE_REPLACE_EXISTING)!=0;
+#else
+    return std::rename(temp.c_str(),path.c_str())==0;
+#endif
+}
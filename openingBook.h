@@ -0,0 +1,58 @@
+#ifndef OPENINGBOOK_H
+#define OPENINGBOOK_H
+
+#include "config.h"
+#include "mappedFile.h"
+#include "symmetry.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr const char* DEFAULT_BOOK_FILE="gomoku.book";     //界面和命令行引擎在可执行文件所在目录下找这个文件
+
+//开局库的一条记录，定长16字节，文件里按key升序排列
+//局面和落子都按规范方向存放：八种对称变换下Zobrist键最小的那个方向
+struct BookEntry{
+    uint64_t key;        //规范化后的局面键，已含待落子方
+    uint32_t visits;     //生成这条记录的搜索中该落子的访问次数
+    int16_t value;       //待落子方视角的平均结果，乘以10000取整
+    uint8_t move;        //规范方向下的落子，row*BOARD_COLS+col
+    uint8_t depth;       //局面上的棋子数
+};
+static_assert(sizeof(BookEntry)==16,"开局库记录必须是16字节");
+
+//文件头，后面紧跟count条BookEntry
+struct BookHeader{
+    char magic[8];       //"GMKBOOK1"
+    uint32_t version;
+    uint32_t count;
+};
+
+//开局库：整个文件只读映射进内存，不需要解析，查找是在映射区上二分
+class OpeningBook{
+
+public:
+    OpeningBook()=default;
+
+    bool Open(const std::string& path);        //映射开局库文件，格式不对时返回false并保持未打开
+    void Close() noexcept;
+    bool IsOpen() const noexcept{ return entries!=nullptr; }
+    std::size_t Size() const noexcept{ return count; }
+
+    const BookEntry* Find(uint64_t canonical) const noexcept;                     //按规范键二分查找，找不到返回nullptr
+    std::pair<int,int> Lookup(const ChessBoard& board,Player player) const noexcept;   //库中有该局面时返回实际方向下的落子，否则返回{-1,-1}
+    std::vector<BookEntry> Entries() const;                                      //全部记录的副本，供生成器扩充
+
+    static uint64_t CanonicalKey(const ChessBoard& board,Player player,int& transform) noexcept;   //transform返回取到最小键的对称变换（见symmetry.h）
+    static bool Write(const std::string& path,std::vector<BookEntry> entries);   //排序去重后写出，同一局面保留访问次数多的记录
+
+private:
+    MappedFile file;             //映射区起点是文件头
+    const BookEntry* entries=nullptr;
+    std::size_t count=0;
+
+};
+
+#endif // OPENINGBOOK_H
@@ -0,0 +1,92 @@
+#include "openingBook.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static constexpr char BOOK_MAGIC[8]={'G','M','K','B','O','O','K','1'};
+static constexpr uint32_t BOOK_VERSION=1;
+static constexpr uint64_t WHITE_TO_MOVE=0xD1B54A32D192ED03ull;     //白方待落子时异或进键，区分棋子相同而轮次不同的局面
+
+uint64_t OpeningBook::CanonicalKey(const ChessBoard& board,Player player,int& transform) noexcept{
+    uint64_t keys[SYMMETRIES]={};
+    for(int i=0;i<BOARD_ROWS;i++){
+        for(int j=0;j<BOARD_COLS;j++){
+            Player p=board.grid[i][j];
+            if(p==Player::None) continue;
+            for(int t=0;t<SYMMETRIES;t++){
+                int cell=transform_cell(i*BOARD_COLS+j,t);
+                keys[t]^=zobrist_of(cell/BOARD_COLS,cell%BOARD_COLS,p);
+            }
+        }
+    }
+    transform=0;
+    for(int t=1;t<SYMMETRIES;t++){
+        if(keys[t]<keys[transform]) transform=t;
+    }
+    return keys[transform]^((player==Player::White)? WHITE_TO_MOVE:0);
+}
+
+bool OpeningBook::Open(const std::string& path){
+    Close();
+    if(!file.Open(path)) return false;
+    const BookHeader* header=static_cast<const BookHeader*>(file.Data());
+    if(file.Size()<sizeof(BookHeader)||std::memcmp(header->magic,BOOK_MAGIC,sizeof(BOOK_MAGIC))!=0||header->version!=BOOK_VERSION||
+       file.Size()!=sizeof(BookHeader)+static_cast<std::size_t>(header->count)*sizeof(BookEntry)){
+        Close();
+        return false;
+    }
+    entries=reinterpret_cast<const BookEntry*>(static_cast<const char*>(file.Data())+sizeof(BookHeader));
+    count=header->count;
+    return true;
+}
+
+void OpeningBook::Close() noexcept{
+    file.Close();
+    entries=nullptr;
+    count=0;
+}
+
+const BookEntry* OpeningBook::Find(uint64_t canonical) const noexcept{
+    if(entries==nullptr) return nullptr;
+    const BookEntry* end=entries+count;
+    const BookEntry* it=std::lower_bound(entries,end,canonical,[](const BookEntry& e,uint64_t key){ return e.key<key; });
+    return (it!=end&&it->key==canonical)? it:nullptr;
+}
+
+std::pair<int,int> OpeningBook::Lookup(const ChessBoard& board,Player player) const noexcept{
+    if(entries==nullptr) return {-1,-1};
+    int transform;
+    const BookEntry* entry=Find(CanonicalKey(board,player,transform));
+    if(entry==nullptr||entry->move>=BOARD_ROWS*BOARD_COLS) return {-1,-1};
+    int cell=transform_cell(entry->move,inverse_symmetry(transform));       //规范方向下的落子变回实际方向
+    int r=cell/BOARD_COLS,c=cell%BOARD_COLS;
+    if(board.grid[r][c]!=Player::None) return {-1,-1};        //64位键冲突时不会落在有子的格子上
+    return {r,c};
+}
+
+std::vector<BookEntry> OpeningBook::Entries() const{
+    return std::vector<BookEntry>(entries,entries+count);
+}
+
+bool OpeningBook::Write(const std::string& path,std::vector<BookEntry> book){
+    std::sort(book.begin(),book.end(),[](const BookEntry& a,const BookEntry& b){
+        return a.key!=b.key? a.key<b.key:a.visits>b.visits;
+    });
+    book.erase(std::unique(book.begin(),book.end(),[](const BookEntry& a,const BookEntry& b){ return a.key==b.key; }),book.end());
+
+    std::string temp=path+".tmp";           //先写临时文件再改名，正在映射旧文件的进程不受影响
+    std::FILE* out=std::fopen(temp.c_str(),"wb");
+    if(out==nullptr) return false;
+    BookHeader header;
+    std::memcpy(header.magic,BOOK_MAGIC,sizeof(BOOK_MAGIC));
+    header.version=BOOK_VERSION;
+    header.count=static_cast<uint32_t>(book.size());
+    bool ok=std::fwrite(&header,sizeof(header),1,out)==1&&
+            (book.empty()||std::fwrite(book.data(),sizeof(BookEntry),book.size(),out)==book.size());
+    ok=(std::fclose(out)==0)&&ok;
+    if(!ok){
+        std::remove(temp.c_str());
+        return false;
+    }
+    return MappedFile::Replace(temp,path);
+}
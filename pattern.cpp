@@ -0,0 +1,76 @@
+#include "pattern.h"
+
+namespace pattern_detail{
+
+constexpr int POW3[SHAPE_CELLS+1]={1,3,9,27,81,243,729,2187,6561};
+
+constexpr std::array<uint16_t,1<<SHAPE_CELLS> make_binary_to_ternary(){
+    std::array<uint16_t,1<<SHAPE_CELLS> table{};
+    for(int mask=0;mask<(1<<SHAPE_CELLS);mask++){
+        int value=0;
+        for(int k=0;k<SHAPE_CELLS;k++){
+            if(mask&(1<<k)) value+=POW3[k];
+        }
+        table[mask]=static_cast<uint16_t>(value);
+    }
+    return table;
+}
+
+//窗口第k格（0-3为中心左侧由远到近，4-7为右侧由近到远）在直线上的位置，中心为SHAPE_WINDOW
+constexpr int cell_pos(int k){
+    return (k<SHAPE_WINDOW)? k:k+1;
+}
+
+//经过中心的己方连续棋子数，中心本身算作己方
+constexpr int center_run(const int (&cells)[2*SHAPE_WINDOW+1]){
+    int run=1;
+    for(int i=SHAPE_WINDOW-1;i>=0&&cells[i]==1;i--) run++;
+    for(int i=SHAPE_WINDOW+1;i<=2*SHAPE_WINDOW&&cells[i]==1;i++) run++;
+    return run;
+}
+
+//按下标从大到小生成：在空位上再落一子会使下标变大，所以需要的后继棋型都已算好
+constexpr std::array<Shape,SHAPE_TABLE_SIZE> make_shape_table(){
+    std::array<Shape,SHAPE_TABLE_SIZE> table{};
+    int cells[2*SHAPE_WINDOW+1]={};
+    for(int k=0;k<SHAPE_CELLS;k++) cells[cell_pos(k)]=2;      //最大下标：窗口内全部被挡住
+    cells[SHAPE_WINDOW]=1;
+    for(int index=SHAPE_TABLE_SIZE-1;index>=0;index--){
+        int run=center_run(cells);
+        Shape shape=Shape::None;
+        if(run==5){
+            shape=Shape::Five;
+        }
+        else{
+            int fives=0;
+            bool open_four=false,four=false,live_three=false;
+            for(int k=0;k<SHAPE_CELLS;k++){
+                if(cells[cell_pos(k)]!=0) continue;
+                Shape next=table[index+POW3[k]];
+                fives+=(next==Shape::Five);
+                open_four|=(next==Shape::OpenFour);
+                four|=(next==Shape::Four);
+                live_three|=(next==Shape::OpenThree||next==Shape::BrokenThree);
+            }
+            if(fives>=2) shape=Shape::OpenFour;
+            else if(fives==1) shape=Shape::Four;
+            else if(open_four) shape=(run==3)? Shape::OpenThree:Shape::BrokenThree;
+            else if(four) shape=Shape::Three;
+            else if(live_three) shape=Shape::Two;
+        }
+        table[index]=shape;
+        for(int k=0;k<SHAPE_CELLS;k++){            //三进制计数器减一，得到下一个下标对应的窗口
+            if(cells[cell_pos(k)]>0){
+                cells[cell_pos(k)]--;
+                break;
+            }
+            cells[cell_pos(k)]=2;
+        }
+    }
+    return table;
+}
+
+}
+
+constexpr std::array<uint16_t,1<<SHAPE_CELLS> BINARY_TO_TERNARY=pattern_detail::make_binary_to_ternary();
+constexpr std::array<Shape,SHAPE_TABLE_SIZE> SHAPE_TABLE=pattern_detail::make_shape_table();
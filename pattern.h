@@ -0,0 +1,53 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "config.h"
+#include <array>
+#include <vector>
+
+//棋型查表：取某一格在一个方向上左右各4格的窗口，假设该格落下己方棋子，一次查表得到经过该格的最强棋型
+//窗口中每格有三种状态（空、己方、被挡住：对方棋子或棋盘外），8格按三进制编码，共3^8个表项，在编译期生成
+//窗口之外的棋子看不到，所以贴着窗口边缘的五连可能实际是长连，胜负判定仍以is_five_at为准
+enum class Shape:uint8_t{
+    None=0,
+    Two,           //活二：再落一子可成活三
+    Three,         //眠三：再落一子只能成冲四
+    BrokenThree,   //跳活三：X_XX，再落一子可成活四
+    OpenThree,     //连活三：XXX，再落一子可成活四
+    Four,          //冲四：只有一个位置能成五
+    OpenFour,      //活四：有两个及以上位置能成五
+    Five           //恰好五连，长连不算
+};
+
+constexpr int SHAPE_WINDOW=4;                    //中心格左右各看4格
+constexpr int SHAPE_CELLS=2*SHAPE_WINDOW;        //不含中心格
+constexpr int SHAPE_TABLE_SIZE=6561;             //3^SHAPE_CELLS
+
+//表在pattern.cpp中由constexpr函数在编译期生成，这里只声明，避免每个包含者都重新求值
+extern const std::array<uint16_t,1<<SHAPE_CELLS> BINARY_TO_TERNARY;   //二进制位到三进制数位的映射，用来把己方/被挡位掩码合成表下标
+extern const std::array<Shape,SHAPE_TABLE_SIZE> SHAPE_TABLE;
+
+//由一条线上双方的位掩码求第p格的棋型下标，len为该线的长度，超出棋盘的部分视为被挡住
+inline int shape_index(uint16_t own_line,uint16_t opp_line,int len,int p) noexcept{
+    uint32_t outside=~((1u<<len)-1);
+    const uint32_t side=(1u<<SHAPE_WINDOW)-1;
+    const uint32_t window=(1u<<(2*SHAPE_WINDOW+1))-1;
+    uint32_t own=((static_cast<uint32_t>(own_line)<<SHAPE_WINDOW)>>p)&window;
+    uint32_t blocked=((((opp_line|outside)<<SHAPE_WINDOW)|side)>>p)&window;
+    own=(own&side)|((own>>(SHAPE_WINDOW+1))<<SHAPE_WINDOW);              //去掉中心格
+    blocked=(blocked&side)|((blocked>>(SHAPE_WINDOW+1))<<SHAPE_WINDOW);
+    return BINARY_TO_TERNARY[own]+2*BINARY_TO_TERNARY[blocked];
+}
+
+//假设(r,c)落下own方的棋子，dir方向（0横 1竖 2主对角 3副对角）上经过该格的棋型
+inline Shape line_shape(const BitBoard& own,const BitBoard& opp,const std::vector<std::vector<Diaginfo>>& diag_map,int r,int c,int dir) noexcept{
+    const Diaginfo& d=diag_map[r][c];
+    switch(dir){
+    case 0: return SHAPE_TABLE[shape_index(own.row[r],opp.row[r],BOARD_COLS,c)];
+    case 1: return SHAPE_TABLE[shape_index(own.col[c],opp.col[c],BOARD_ROWS,r)];
+    case 2: return SHAPE_TABLE[shape_index(own.diag1[d.diag1_id],opp.diag1[d.diag1_id],BOARD_COLS-(r>c? r-c:c-r),d.diag1_off)];
+    default: return SHAPE_TABLE[shape_index(own.diag2[d.diag2_id],opp.diag2[d.diag2_id],BOARD_COLS-(r+c>BOARD_COLS-1? r+c-(BOARD_COLS-1):(BOARD_COLS-1)-(r+c)),d.diag2_off)];
+    }
+}
+
+#endif // PATTERN_H
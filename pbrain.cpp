@@ -0,0 +1,164 @@
+//Gomocup（piskvork）协议的命令行引擎，通过标准输入输出与管理程序通信，不依赖Qt
+//协议中的坐标为"x,y"，x是列、y是行，与GomokuGame的(row,col)相反
+#include "GomokuGame.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TimeControl{
+    long long turn_ms=5000;       //INFO timeout_turn，0表示尽快落子
+    long long left_ms=-1;         //INFO time_left，-1表示没有整局时限
+};
+
+void reply(const std::string& line){
+    std::cout<<line<<std::endl;   //每行都要立即刷新，管理程序按行读取
+}
+
+SearchLimits limits_for(const TimeControl& time){
+    SearchLimits limits;
+    double ms=static_cast<double>(time.turn_ms);
+    if(time.turn_ms<=0) ms=10.0;
+    if(time.left_ms>=0) ms=std::min(ms,time.left_ms/10.0);    //整局剩余时间按还需约10步分配
+    limits.seconds=std::max(0.005,(ms*0.9-30.0)/1000.0);      //留出进程通信的余量
+    return limits;
+}
+
+bool parse_coord(const std::string& text,int& x,int& y){
+    char comma=0;
+    std::istringstream in(text);
+    return static_cast<bool>(in>>x>>comma>>y)&&comma==',';
+}
+
+//AI落子并按协议输出"x,y"
+void play(GomokuGame& game,const TimeControl& time){
+    std::pair<int,int> move=game.GetAIMove(limits_for(time));
+    if(move.first<0||!game.Make_Move(move.first,move.second,game.GetCurPlayer())){
+        reply("ERROR no legal move");
+        return;
+    }
+    SearchInfo info=game.GetSearchInfo();
+    reply("MESSAGE playouts "+std::to_string(info.playouts)+" in "+std::to_string(static_cast<int>(info.seconds*1000))+" ms, tree "+
+          std::to_string(info.tree_bytes>>10)+" KB, evicted "+std::to_string(info.evicted));      //常见的树只有几MB，按KB报告
+    reply(std::to_string(move.second)+","+std::to_string(move.first));
+}
+
+//BOARD命令后的落子列表，1为己方，2为对方；3是连续对局（continuous game）的标记，其余取值也不是棋子，都忽略
+//双方交替摆放，使黑子先于白子，摆完后正好轮到己方
+void load_board(GomokuGame& game,const TimeControl& time){
+    std::vector<std::pair<int,int>> own,opp;
+    std::string line;
+    while(std::getline(std::cin,line)){
+        if(!line.empty()&&line.back()=='\r') line.pop_back();
+        if(line=="DONE") break;
+        int x,y,who;
+        char c1=0,c2=0;
+        std::istringstream in(line);
+        if(!(in>>x>>c1>>y>>c2>>who)||c1!=','||c2!=',') continue;
+        if(who==1) own.push_back({y,x});
+        else if(who==2) opp.push_back({y,x});
+    }
+    game.StartGame(false);
+    Player me=(own.size()<opp.size())? Player::White:Player::Black;
+    std::vector<std::pair<int,int>>& black=(me==Player::Black)? own:opp;
+    std::vector<std::pair<int,int>>& white=(me==Player::Black)? opp:own;
+    for(std::size_t i=0;i<std::max(black.size(),white.size());i++){
+        if(i<black.size()) game.Make_Move(black[i].first,black[i].second,Player::Black);
+        if(i<white.size()) game.Make_Move(white[i].first,white[i].second,Player::White);
+    }
+    play(game,time);
+}
+
+}
+
+int main(int argc,char* argv[]){
+    std::ios::sync_with_stdio(false);
+    GomokuGame game;
+    SearchConfig config;
+    config.threads=std::max(1u,std::thread::hardware_concurrency());
+    config.rollout.mode=RolloutMode::Pattern;       //同样用时下比随机推演强，引擎不用批量模式，没有损失
+    game.SetSearchConfig(config);
+    std::string dir=(argc>0)? argv[0]:"";
+    std::size_t slash=dir.find_last_of("/\\");
+    dir=(slash==std::string::npos)? "":dir.substr(0,slash+1);
+    game.LoadOpeningBook(dir+DEFAULT_BOOK_FILE);        //可执行文件旁边有开局库就用，没有时照常搜索
+    if(const char* log=std::getenv("GOMOKU_TELEMETRY_LOG")) game.SetTelemetryLog(log);    //每步的遥测按JSON行追加到该文件
+    TimeControl time;
+
+    std::string line;
+    while(std::getline(std::cin,line)){
+        if(!line.empty()&&line.back()=='\r') line.pop_back();
+        std::istringstream in(line);
+        std::string command;
+        in>>command;
+        std::transform(command.begin(),command.end(),command.begin(),[](unsigned char ch){ return std::toupper(ch); });
+
+        if(command=="START"){
+            int size=0;
+            in>>size;
+            if(size!=BOARD_ROWS){
+                reply("ERROR only "+std::to_string(BOARD_ROWS)+"x"+std::to_string(BOARD_COLS)+" boards are supported");
+                continue;
+            }
+            game.StartGame(false);
+            reply("OK");
+        }
+        else if(command=="RESTART"){
+            game.StartGame(false);
+            reply("OK");
+        }
+        else if(command=="BEGIN"){
+            play(game,time);
+        }
+        else if(command=="TURN"){
+            std::string coord;
+            std::getline(in,coord);
+            int x,y;
+            if(!parse_coord(coord,x,y)||!game.Make_Move(y,x,game.GetCurPlayer())){
+                reply("ERROR invalid move "+coord);
+                continue;
+            }
+            play(game,time);
+        }
+        else if(command=="BOARD"){
+            load_board(game,time);
+        }
+        else if(command=="INFO"){
+            std::string key;
+            in>>key;
+            if(key=="folder"){            //管理程序允许写持久文件的目录，有了它才开启搜索缓存
+                std::string folder;
+                std::getline(in>>std::ws,folder);
+                if(!folder.empty()&&folder.back()!='/'&&folder.back()!='\\') folder+='/';
+                if(!folder.empty()) game.EnableSearchCache(folder+DEFAULT_CACHE_FILE);
+                continue;
+            }
+            long long value=0;
+            in>>value;
+            if(key=="timeout_turn") time.turn_ms=value;
+            else if(key=="time_left") time.left_ms=value;
+            else if(key=="max_memory"){       //字节数，0表示不限；树之外留出推演、开局库等的余量
+                SearchConfig config=game.GetSearchConfig();
+                config.memory_budget=(value>0)? static_cast<std::size_t>(value/10*8):0;
+                config.when_full=TreeFullPolicy::Evict;
+                game.SetSearchConfig(config);
+            }
+        }
+        else if(command=="ABOUT"){
+            reply("name=\"Gomoku_ai\", version=\"0.1\", author=\"Gomoku_ai\", country=\"CN\"");
+        }
+        else if(command=="END"){
+            break;
+        }
+        else if(!command.empty()){
+            reply("UNKNOWN "+command);
+        }
+    }
+    return 0;
+}
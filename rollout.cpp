@@ -0,0 +1,365 @@
+#include "rollout.h"
+#include "bitBoard.h"
+#include "board256.h"
+#include "threatIndex.h"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+static std::atomic<uint64_t> rollout_seed{std::random_device{}()};
+static std::atomic<uint64_t> thread_count{0};
+
+//每个格子所在的两条对角线及偏移，与init_Diag_map的编号一致；编译期生成的平坦表，省去推演内层循环里vector的两次间接访问
+struct CellLines{
+    uint8_t diag1_id,diag1_off;
+    uint8_t diag2_id,diag2_off;
+};
+
+static constexpr std::array<CellLines,BOARD_ROWS*BOARD_COLS> make_cell_lines(){
+    std::array<CellLines,BOARD_ROWS*BOARD_COLS> lines{};
+    for(int r=0;r<BOARD_ROWS;r++){
+        for(int c=0;c<BOARD_COLS;c++){
+            CellLines& d=lines[r*BOARD_COLS+c];
+            d.diag1_id=static_cast<uint8_t>(r-c+(BOARD_COLS-1));
+            d.diag1_off=static_cast<uint8_t>(r<c? r:c);
+            d.diag2_id=static_cast<uint8_t>(r+c);
+            d.diag2_off=static_cast<uint8_t>(r<BOARD_COLS-1-c? r:BOARD_COLS-1-c);
+        }
+    }
+    return lines;
+}
+
+static constexpr std::array<CellLines,BOARD_ROWS*BOARD_COLS> CELL_LINES=make_cell_lines();
+
+static inline void place(BitBoard& bitboard,int r,int c) noexcept{
+    const CellLines& d=CELL_LINES[r*BOARD_COLS+c];
+    bitboard.row[r]|=static_cast<uint16_t>(1u<<c);
+    bitboard.col[c]|=static_cast<uint16_t>(1u<<r);
+    bitboard.diag1[d.diag1_id]|=static_cast<uint16_t>(1u<<d.diag1_off);
+    bitboard.diag2[d.diag2_id]|=static_cast<uint16_t>(1u<<d.diag2_off);
+}
+
+static inline bool five_at(const BitBoard& bitboard,int r,int c) noexcept{      //同is_five_at
+    const CellLines& d=CELL_LINES[r*BOARD_COLS+c];
+    return run_length(bitboard.row[r],c)==5||run_length(bitboard.col[c],r)==5||
+           run_length(bitboard.diag1[d.diag1_id],d.diag1_off)==5||run_length(bitboard.diag2[d.diag2_id],d.diag2_off)==5;
+}
+
+//推演内层循环的两种棋子表示：四个方向的16位线掩码只检查经过落子的四条线；
+//整盘256位位棋盘落子只需一次按位或，但五连要整盘检查，只有AVX-512下才比前者快
+struct LineStones{
+    BitBoard stones[2]={};
+    void set(int side,int r,int c) noexcept{ place(stones[side],r,c); }
+    bool five(int side,int r,int c) const noexcept{ return five_at(stones[side],r,c); }
+    Board256 wide(int side) const noexcept{         //按行拼成整盘位棋盘，每行16位
+        Board256 board;
+        for(int r=0;r<BOARD_ROWS;r++){
+            board.word[r>>2]|=static_cast<uint64_t>(stones[side].row[r])<<((r&3)<<4);
+        }
+        return board;
+    }
+};
+
+struct WideStones{
+    Board256 stones[2];
+    void set(int side,int r,int c) noexcept{ stones[side].set(r,c); }
+    bool five(int side,int,int) const noexcept{ return has_five(stones[side]); }
+    Board256 wide(int side) const noexcept{ return stones[side]; }
+};
+
+RolloutRng& thread_rng(){
+    thread_local RolloutRng rng(rollout_seed.load(std::memory_order_relaxed)+0x9E3779B97F4A7C15ull*thread_count.fetch_add(1,std::memory_order_relaxed));
+    return rng;
+}
+
+void seed_rollouts(uint64_t seed){
+    rollout_seed.store(seed,std::memory_order_relaxed);
+    thread_count.store(0,std::memory_order_relaxed);
+    thread_rng().reseed(seed);
+}
+
+//一局推演的全部状态，都在栈上；批量推演时每条通道一个
+template<typename Stones>
+struct Lane{
+    Stones stones;                  //0黑1白
+    CellList empty,centre;
+    Player player;                  //下一步的落子方
+
+    void init(const ChessBoard& board,Player first) noexcept{
+        player=first;
+        std::memset(centre.where,CellList::ABSENT,sizeof(centre.where));   //落子时两个列表都要删，不在中心区域的格子需标记为不存在
+        std::memset(empty.where,CellList::ABSENT,sizeof(empty.where));     //按棋型推演据此判断格子是否为空
+        empty.size=0;
+        centre.size=0;
+        int x=0,y=0,pieces=0;
+        for(int i=0;i<BOARD_ROWS;i++){
+            for(int j=0;j<BOARD_COLS;j++){
+                if(board.grid[i][j]==Player::None){
+                    empty.push(static_cast<uint8_t>(i*BOARD_COLS+j));
+                }
+                else{
+                    stones.set(board.grid[i][j]==Player::Black? 0:1,i,j);
+                    x+=i;
+                    y+=j;
+                    pieces++;
+                }
+            }
+        }
+
+        int range=2;
+        if(pieces>20) range+=2;             //根据棋子数动态改变中心区域的大小
+        if(pieces>34) range+=1;
+        if(pieces>54) range+=1;
+        if(pieces>74) range+=1;
+        int cx=BOARD_ROWS/2,cy=BOARD_COLS/2;
+        if(pieces>0){
+            cx=static_cast<int>(std::round(1.0*x/pieces));
+            cy=static_cast<int>(std::round(1.0*y/pieces));
+        }
+        for(int k=0;k<empty.size;k++){
+            int r=empty.cells[k]/BOARD_COLS,c=empty.cells[k]%BOARD_COLS;
+            if(r>=cx-range&&r<=cx+range&&c>=cy-range&&c<=cy+range) centre.push(empty.cells[k]);
+        }
+    }
+
+    uint8_t pick(RolloutRng& rng) const noexcept{     //随机选一个空位，调用前须有空位
+        if(centre.size>0&&rng.below(100)<static_cast<uint32_t>(centre.size*5)){    //中心可落子的点越少，越容易退化成全局落子
+            return centre.cells[rng.below(centre.size)];
+        }
+        return empty.cells[rng.below(empty.size)];
+    }
+
+    void place(uint8_t cell) noexcept{
+        empty.erase(cell);
+        centre.erase(cell);
+        stones.set(side(),cell/BOARD_COLS,cell%BOARD_COLS);
+    }
+
+    uint8_t play(RolloutRng& rng) noexcept{      //随机落一子，返回落子位置
+        uint8_t cell=pick(rng);
+        place(cell);
+        return cell;
+    }
+
+    int side() const noexcept{ return (player==Player::Black)? 0:1; }
+    void pass_turn() noexcept{ player=(player==Player::Black)? Player::White:Player::Black; }
+
+    void stones_to(Board256* out) const noexcept{
+        if(out==nullptr) return;
+        out[0]=stones.wide(0);
+        out[1]=stones.wide(1);
+    }
+};
+
+template<typename Stones>
+static Player rollout_on(const ChessBoard& board,Player player,RolloutRng& rng,Board256* out) noexcept{
+    Lane<Stones> lane;
+    lane.init(board,player);
+    Player winner=Player::None;
+    while(lane.empty.size>0){
+        uint8_t cell=lane.play(rng);
+        if(lane.stones.five(lane.side(),cell/BOARD_COLS,cell%BOARD_COLS)){     //推演从非终局开始，只需检查每步的落子
+            winner=lane.player;
+            break;
+        }
+        lane.pass_turn();
+    }
+    lane.stones_to(out);
+    return winner;
+}
+
+//各通道每轮各落一子，然后一起检查胜负：整盘位棋盘用has_five_many成对检查，线掩码逐通道检查落子所在的线
+static uint32_t check_lanes(Lane<WideStones>* lanes,const int* active,const uint8_t*,int n) noexcept{
+    const Board256* boards[MAX_ROLLOUT_BATCH];
+    for(int k=0;k<n;k++){
+        Lane<WideStones>& lane=lanes[active[k]];
+        boards[k]=&lane.stones.stones[lane.side()];
+    }
+    return has_five_many(boards,n);
+}
+
+static uint32_t check_lanes(Lane<LineStones>* lanes,const int* active,const uint8_t* cells,int n) noexcept{
+    uint32_t mask=0;
+    for(int k=0;k<n;k++){
+        Lane<LineStones>& lane=lanes[active[k]];
+        if(lane.stones.five(lane.side(),cells[k]/BOARD_COLS,cells[k]%BOARD_COLS)) mask|=1u<<k;
+    }
+    return mask;
+}
+
+template<typename Stones>
+static void rollout_batch_on(const ChessBoard* boards,const Player* players,int n,RolloutRng& rng,Player* winners,Board256* out) noexcept{
+    Lane<Stones> lanes[MAX_ROLLOUT_BATCH];
+    int active[MAX_ROLLOUT_BATCH];
+    uint8_t cells[MAX_ROLLOUT_BATCH];
+    int count=0;
+    for(int i=0;i<n;i++){
+        lanes[i].init(boards[i],players[i]);
+        winners[i]=Player::None;
+        if(lanes[i].empty.size>0) active[count++]=i;
+    }
+    while(count>0){
+        for(int k=0;k<count;k++){
+            cells[k]=lanes[active[k]].play(rng);
+        }
+        uint32_t won=check_lanes(lanes,active,cells,count);
+        int kept=0;
+        for(int k=0;k<count;k++){              //结束的通道移出活动列表，其余换手继续
+            Lane<Stones>& lane=lanes[active[k]];
+            if(won>>k&1u){
+                winners[active[k]]=lane.player;
+                continue;
+            }
+            lane.pass_turn();
+            if(lane.empty.size>0) active[kept++]=active[k];
+        }
+        count=kept;
+    }
+    if(out==nullptr) return;
+    for(int i=0;i<n;i++){
+        lanes[i].stones_to(out+2*i);
+    }
+}
+
+static const int DIR_R[8]={0,1,1,1,0,-1,-1,-1};      //前四个与line_shape的方向编号一致，后四个是反方向
+static const int DIR_C[8]={1,0,1,-1,-1,0,-1,1};
+static constexpr uint8_t NO_CELL=0xFF;
+
+//(r,c)所在的四条线：dir方向上的线掩码、线长和该格在线上的位置
+static inline void line_of(const BitBoard& stones,int r,int c,int dir,uint16_t& line,int& len,int& p) noexcept{
+    const CellLines& d=CELL_LINES[r*BOARD_COLS+c];
+    switch(dir){
+    case 0: line=stones.row[r]; len=BOARD_COLS; p=c; break;
+    case 1: line=stones.col[c]; len=BOARD_ROWS; p=r; break;
+    case 2: line=stones.diag1[d.diag1_id]; len=BOARD_COLS-(r>c? r-c:c-r); p=d.diag1_off; break;
+    default: line=stones.diag2[d.diag2_id]; len=BOARD_COLS-(r+c>BOARD_COLS-1? r+c-(BOARD_COLS-1):(BOARD_COLS-1)-(r+c)); p=d.diag2_off; break;
+    }
+}
+
+//按棋型的推演，在Uniform的状态上另外维护双方的成五位点：落子只会改变经过它的四条线上前后5格的成五位点，
+//而且只有这一方在窗口内至少有4子的线才需要重查；其余时候按最近两手附近的棋型挑点，查表只针对抽到的几个格子
+struct PatternLane{
+    Lane<LineStones> lane;
+    CellSet win[2];                             //落子即恰好成五的空位
+    uint8_t last[2]={NO_CELL,NO_CELL};          //双方最近一次的落子
+
+    void init(const ChessBoard& board,Player first) noexcept{
+        lane.init(board,first);
+        for(int i=0;i<BOARD_ROWS;i++){
+            for(int j=0;j<BOARD_COLS;j++){
+                if(board.grid[i][j]!=Player::None) continue;
+                for(int s=0;s<2;s++){
+                    if(five_if_placed(s,i,j)) win[s].set(i,j);
+                }
+            }
+        }
+    }
+
+    bool five_if_placed(int s,int r,int c) const noexcept{
+        for(int dir=0;dir<4;dir++){
+            uint16_t line;
+            int len,p;
+            line_of(lane.stones.stones[s],r,c,dir,line,len,p);
+            if(run_length(static_cast<uint16_t>(line|(1u<<p)),p)==5) return true;
+        }
+        return false;
+    }
+
+    int weight(const RolloutPolicy& policy,int s,int r,int c) const noexcept{
+        int w=0;
+        for(int dir=0;dir<4;dir++){
+            uint16_t own,opp;
+            int len,p;
+            line_of(lane.stones.stones[s],r,c,dir,own,len,p);
+            line_of(lane.stones.stones[1-s],r,c,dir,opp,len,p);
+            w+=policy.attack[static_cast<int>(SHAPE_TABLE[shape_index(own,opp,len,p)])]+policy.defend[static_cast<int>(SHAPE_TABLE[shape_index(opp,own,len,p)])];
+        }
+        return w;
+    }
+
+    uint8_t choose(const RolloutPolicy& policy,RolloutRng& rng) const noexcept{      //调用前须有空位，且落子方没有成五位点
+        int s=lane.side();
+        std::pair<int,int> block=win[1-s].first();        //对方冲四，必须挡
+        if(block.first!=-1) return static_cast<uint8_t>(block.first*BOARD_COLS+block.second);
+        if(rng.below(100)>=policy.local_percent||(last[0]==NO_CELL&&last[1]==NO_CELL)) return lane.pick(rng);
+        //在最近两手周围（八个方向上一到两格）抽几个空位，取棋型权重最大的
+        uint8_t best=NO_CELL;
+        int best_weight=-1;
+        for(int k=0;k<policy.samples;k++){
+            uint8_t anchor=last[rng.below(2)];
+            if(anchor==NO_CELL) anchor=last[0]==NO_CELL? last[1]:last[0];
+            uint32_t draw=rng.below(16);
+            int r=anchor/BOARD_COLS+DIR_R[draw&7]*(1+(draw>>3)),c=anchor%BOARD_COLS+DIR_C[draw&7]*(1+(draw>>3));
+            if(r<0||r>=BOARD_ROWS||c<0||c>=BOARD_COLS) continue;
+            uint8_t cell=static_cast<uint8_t>(r*BOARD_COLS+c);
+            if(lane.empty.where[cell]==CellList::ABSENT) continue;
+            int w=weight(policy,s,r,c);
+            if(w>best_weight){
+                best_weight=w;
+                best=cell;
+            }
+        }
+        return best!=NO_CELL? best:lane.pick(rng);
+    }
+
+    void play(uint8_t cell) noexcept{
+        int s=lane.side();
+        int r=cell/BOARD_COLS,c=cell%BOARD_COLS;
+        lane.place(cell);
+        win[0].reset(r,c);
+        win[1].reset(r,c);
+        for(int dir=0;dir<4;dir++){
+            uint16_t own,opp;
+            int len,p;
+            line_of(lane.stones.stones[s],r,c,dir,own,len,p);
+            line_of(lane.stones.stones[1-s],r,c,dir,opp,len,p);
+            const uint32_t window=(1u<<9)-1;
+            if(__builtin_popcount((static_cast<uint32_t>(own)<<4>>p)&window)<4) continue;     //前后4格内己方不到4子（含本子），这条线上不会有新的成五位点，也不会有旧的变成长连
+            for(int k=-5;k<=5;k++){
+                int q=p+k;
+                if(k==0||q<0||q>=len||((own|opp)>>q&1u)) continue;
+                int i=r+k*DIR_R[dir],j=c+k*DIR_C[dir];
+                if(five_if_placed(s,i,j)) win[s].set(i,j);
+                else win[s].reset(i,j);
+            }
+        }
+        last[s]=cell;
+        lane.pass_turn();
+    }
+};
+
+static Player rollout_pattern(const ChessBoard& board,Player player,RolloutRng& rng,const RolloutPolicy& policy,Board256* out) noexcept{
+    PatternLane lane;
+    lane.init(board,player);
+    while(lane.lane.empty.size>0){
+        std::pair<int,int> five=lane.win[lane.lane.side()].first();
+        if(five.first!=-1){             //有成五位点就是胜局，不必真的落下
+            lane.lane.stones_to(out);
+            if(out!=nullptr) out[lane.lane.side()].set(five.first,five.second);
+            return lane.lane.player;
+        }
+        lane.play(lane.choose(policy,rng));
+    }
+    lane.lane.stones_to(out);
+    return Player::None;
+}
+
+Player rollout(const ChessBoard& board,Player player,RolloutRng& rng,const RolloutPolicy& policy,Board256* stones) noexcept{
+    if(policy.mode==RolloutMode::Pattern) return rollout_pattern(board,player,rng,policy,stones);
+    static const bool wide=(detected_simd_level()==SimdLevel::AVX512);
+    return wide? rollout_on<WideStones>(board,player,rng,stones):rollout_on<LineStones>(board,player,rng,stones);
+}
+
+void rollout_batch(const ChessBoard* boards,const Player* players,int n,RolloutRng& rng,Player* winners,const RolloutPolicy& policy,Board256* stones) noexcept{
+    if(policy.mode==RolloutMode::Pattern){
+        for(int i=0;i<n;i++){
+            winners[i]=rollout_pattern(boards[i],players[i],rng,policy,stones==nullptr? nullptr:stones+2*i);
+        }
+        return;
+    }
+    static const bool wide=(detected_simd_level()==SimdLevel::AVX512);
+    if(wide) rollout_batch_on<WideStones>(boards,players,n,rng,winners,stones);
+    else rollout_batch_on<LineStones>(boards,players,n,rng,winners,stones);
+}
@@ -0,0 +1,100 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "config.h"
+#include "board256.h"
+#include <cstdint>
+
+//xoshiro256**：每个搜索线程各持有一个，状态只有32字节，不加锁也不分配内存
+class RolloutRng{
+
+public:
+    explicit RolloutRng(uint64_t seed=0) noexcept{ reseed(seed); }
+
+    void reseed(uint64_t seed) noexcept{
+        for(uint64_t& word : s){           //用splitmix64把种子展开成四个不全为0的状态字
+            seed+=0x9E3779B97F4A7C15ull;
+            uint64_t z=seed;
+            z=(z^(z>>30))*0xBF58476D1CE4E5B9ull;
+            z=(z^(z>>27))*0x94D049BB133111EBull;
+            word=z^(z>>31);
+        }
+    }
+
+    uint64_t next() noexcept{
+        uint64_t result=rotl(s[1]*5,7)*9;
+        uint64_t t=s[1]<<17;
+        s[2]^=s[0];
+        s[3]^=s[1];
+        s[1]^=s[2];
+        s[0]^=s[3];
+        s[2]^=t;
+        s[3]=rotl(s[3],45);
+        return result;
+    }
+
+    uint32_t below(uint32_t n) noexcept{    //[0,n)内的均匀整数，用乘法取高位代替取模
+        return static_cast<uint32_t>(((next()>>32)*n)>>32);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x,int k) noexcept{ return (x<<k)|(x>>(64-k)); }
+    uint64_t s[4];
+
+};
+
+RolloutRng& thread_rng();                    //当前线程的发生器，首次使用时由全局种子和线程序号派生
+void seed_rollouts(uint64_t seed);           //设置全局种子，之后新建的线程得到可复现的随机序列
+
+//定长的格子列表：记录每个格子在列表中的位置，删除任意格子都是O(1)
+struct CellList{
+    static constexpr uint8_t ABSENT=0xFF;
+    uint8_t cells[BOARD_ROWS*BOARD_COLS];
+    uint8_t where[BOARD_ROWS*BOARD_COLS];
+    int size=0;
+
+    void push(uint8_t cell) noexcept{
+        where[cell]=static_cast<uint8_t>(size);
+        cells[size++]=cell;
+    }
+    void erase(uint8_t cell) noexcept{      //与末尾交换后弹出
+        uint8_t at=where[cell];
+        if(at==ABSENT) return;
+        uint8_t last=cells[--size];
+        cells[at]=last;
+        where[last]=at;
+        where[cell]=ABSENT;
+    }
+};
+
+enum class RolloutMode{
+    Uniform,    //随机落子，偏向棋子重心附近的区域
+    Pattern     //先成五、挡五，其余大多在最近两手附近按棋型权重挑点
+};
+
+//推演策略及Pattern模式的参数，可以在两次搜索之间随时修改
+//attack、defend按Shape取值：某个空位对落子方形成该棋型时加attack，对对方形成该棋型时加defend（占住即是防守），四个方向累加
+//默认仍是Uniform：Pattern每局强得多，但rollout_batch对它只能逐局推演，批量模式失去作用，由调用者按需选用
+struct RolloutPolicy{
+    RolloutMode mode=RolloutMode::Uniform;
+    uint16_t attack[8]={0,2,3,6,10,6,300,0};
+    uint16_t defend[8]={0,2,3,8,10,20,150,0};
+    uint8_t local_percent=70;           //每步以该概率在最近两手附近挑点，否则按Uniform的规则随机落子
+    uint8_t samples=4;                  //附近挑点时抽取的空位数，取其中权重最大的
+};
+
+//从board开始由player先走，双方按policy落子直到一方恰好五连或棋盘下满，返回胜者（和棋为Player::None）
+//Uniform：中心区域的空位越多，从中心取点的概率越大，空位少时退化为全盘随机
+//Pattern：另外随落子增量维护双方的成五位点，有则成五或挡住，棋型只对抽到的几个格子查表
+//整个推演只使用栈上的位棋盘和定长列表，不分配堆内存
+//stones非空时写入推演结束时双方的棋子（stones[0]黑、stones[1]白，含起始局面），供RAVE更新AMAF统计；Pattern提前判胜时胜方的成五一子也计入
+Player rollout(const ChessBoard& board,Player player,RolloutRng& rng,const RolloutPolicy& policy=RolloutPolicy{},Board256* stones=nullptr) noexcept;
+
+constexpr int MAX_ROLLOUT_BATCH=32;
+
+//批量推演：n（不超过MAX_ROLLOUT_BATCH）局互不相关的推演，胜者写入winners[i]
+//Uniform时各局同步进行，每轮各落一子后一起检查胜负，已结束的局移出活动列表；Pattern的每步判断分支多，不做批量，逐局调用rollout
+//stones非空时第i局的结果棋子写入stones[2*i]和stones[2*i+1]，含义同rollout
+void rollout_batch(const ChessBoard* boards,const Player* players,int n,RolloutRng& rng,Player* winners,const RolloutPolicy& policy=RolloutPolicy{},Board256* stones=nullptr) noexcept;
+
+#endif // ROLLOUT_H
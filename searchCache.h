@@ -0,0 +1,76 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include "config.h"
+#include "mappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+constexpr const char* DEFAULT_CACHE_FILE="gomoku.cache";
+
+//缓存的一条记录，定长16字节
+struct CacheEntry{
+    uint64_t key;        //SearchCache::Key，0表示空位
+    uint32_t visits;     //写入时该节点的访问次数
+    int32_t wins;        //胜负累计，黑方视角，与TreeNode::win相同
+};
+static_assert(sizeof(CacheEntry)==16,"搜索缓存记录必须是16字节");
+
+//文件头，后面紧跟buckets*CACHE_WAYS条CacheEntry
+struct CacheHeader{
+    char magic[8];       //"GMKCACH1"
+    uint32_t version;
+    uint32_t buckets;    //2的幂
+};
+
+constexpr int CACHE_WAYS=4;     //每个桶4条记录，正好一条缓存行，查一次只读一行
+
+struct SearchCacheOptions{
+    uint32_t min_visits=256;           //访问次数达到这个数的节点才写入缓存
+    uint32_t max_prior=1024;           //取出的统计按比例缩到最多这么多次访问，旧统计只起引导作用，不压住本次搜索
+    std::size_t capacity=1u<<18;       //最多保存的局面数，文件大小约为capacity*16字节
+};
+
+//跨对局、跨进程的搜索缓存：文件是定长的组相联哈希表，只读映射进内存，搜索扩展节点时按键查一个桶，
+//只有真正查到的页才会被读入；对局中访问次数多的局面先记在内存里，对局结束时由后台线程并入新文件再改名替换，
+//桶满时挤掉访问次数最少的记录，文件大小固定
+class SearchCache{
+
+public:
+    SearchCache()=default;
+    ~SearchCache();
+    SearchCache(const SearchCache&)=delete;
+    SearchCache& operator=(const SearchCache&)=delete;
+
+    bool Open(const std::string& path,const SearchCacheOptions& options=SearchCacheOptions{});   //文件不存在时从空缓存开始；文件存在但不是缓存文件时返回false，不会覆盖它
+    void Close();                       //同步写出尚未写出的记录后关闭
+    bool IsOpen() const noexcept{ return !path.empty(); }
+    std::size_t Size() const noexcept;  //映射中的记录数
+
+    bool Prior(uint64_t key,uint32_t& visits,int32_t& wins) const noexcept;   //查到时按max_prior缩放后返回，可与搜索线程并发调用
+    void Record(uint64_t key,uint32_t visits,int32_t wins);                  //记入待写出的记录，同一局面保留访问次数多的
+    void Flush();                       //换用上一次后台写出的文件，再把待写出的记录交给后台线程；调用时不能有搜索在查缓存
+    uint32_t MinVisits() const noexcept{ return options.min_visits; }
+
+    static uint64_t Key(uint64_t zobrist,Player player) noexcept;   //局面键异或待落子方，空棋盘的键也不为0
+
+private:
+    const CacheEntry* find(uint64_t key) const noexcept;
+    void reload();                                  //等后台线程写完，改名替换旧文件并重新映射
+    bool write(std::unordered_map<uint64_t,CacheEntry> records) const;    //在后台线程上运行：旧表与新记录合并后写到临时文件
+
+    std::string path;
+    SearchCacheOptions options;
+    MappedFile file;
+    const CacheEntry* table=nullptr;
+    std::size_t bucket_mask=0;
+    std::unordered_map<uint64_t,CacheEntry> pending;
+    std::thread writer;
+    bool written=false;             //后台线程的结果，join之后才读
+
+};
+
+#endif // SEARCHCACHE_H
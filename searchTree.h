@@ -0,0 +1,131 @@
+#ifndef SEARCHTREE_H
+#define SEARCHTREE_H
+
+#include "config.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//MCT树的节点池：节点和子边都放在预先分配的连续数组里，用下标代替棋盘作为节点的标识
+//每条边压缩成一个uint32：低8位是落子位置，高24位是子节点下标（0表示尚未扩展，0号节点总是根）
+//节点和边都用原子计数器分配，多个搜索线程可以同时扩展同一棵树而不需要全局锁
+//开启置换后同一局面只对应一个节点，树变成有向无环图：每条边另有自己的访问和胜负统计，
+//节点的统计是经过它的所有路径之和，节点的parent只记录第一次创建它的父节点，回传必须沿SearchPath
+//开启AMAF后每条边另有一组"所有落子视为首手"的统计：该落子在这条边之后的任何时刻被同一方下过，就算作经过了这条边
+class SearchTree{
+
+public:
+    explicit SearchTree(std::size_t node_capacity=DEFAULT_NODE_CAPACITY,std::size_t edge_capacity=DEFAULT_EDGE_CAPACITY);
+    ~SearchTree();
+    SearchTree(const SearchTree&)=delete;
+    SearchTree& operator=(const SearchTree&)=delete;
+
+    void clear(Player player,uint64_t key);                        //清空节点池，只保留一个新的根节点
+    void reroot(uint8_t move,Player player,uint64_t key);          //以落子move对应的子节点为新根，O(1)原地提升，池用过一半时再整理（不能与搜索同时进行）
+    void compact();                                                //把根的子树复制到备用池并重新编号，回收不可达的节点和边
+    std::size_t evict();                                           //整理时丢弃访问次数少的子树，使节点池和边池都降到一半以下，返回丢弃的可达节点数（不能与搜索同时进行）
+    void resize(std::size_t node_capacity,std::size_t edge_capacity);   //按新容量重新分配节点池，树被清空（不能与搜索同时进行）
+    bool nearly_full() const noexcept;                             //节点池或边池已用过7/8
+    std::size_t capacity() const noexcept{ return node_capacity; }
+
+    void set_transpositions(bool on);                              //开关置换表和边统计，调用后需clear（不能与搜索同时进行）
+    bool transpositions() const noexcept{ return dag; }
+    std::size_t table_slots() const noexcept{ return dag? table_mask+1:0; }   //置换表的槽数，未开启置换时为0
+    void set_amaf(bool on);                                        //开关边上的AMAF统计，关闭时保留已分配的内存；调用后需clear（不能与搜索同时进行）
+    bool amaf() const noexcept{ return amaf_stats; }
+
+    uint32_t new_node(uint32_t parent,uint8_t move,Player player); //分配一个节点，池满时返回NULL_NODE
+    uint32_t find_or_add(uint32_t parent,uint8_t move,Player player,Proof proof,uint64_t key,uint32_t prior_visits=0,int32_t prior_wins=0);   //开启置换时先按键查找已有节点，找不到再分配并登记，新节点的统计从prior开始；池满时返回NULL_NODE
+    bool init_edges(uint32_t node,const uint8_t* moves,int num,bool all_moves=false);   //为节点生成子边，只有一个线程能成功，边池满时失败；all_moves见TreeNode
+    bool widen_edges(uint32_t node,const uint8_t* moves,int num);  //把moves补进节点的候选落子并标记all_moves，原有的边下标不变；调用者须持有节点的picking锁，且原有的边都已扩展；边池满时失败
+
+    TreeNode& operator[](uint32_t id) noexcept{ return pool().nodes[id]; }
+    const TreeNode& operator[](uint32_t id)const noexcept{ return pool().nodes[id]; }
+    std::atomic<uint32_t>& edge(uint32_t id,int k) noexcept{ return pool().edges[pool().nodes[id].edge_begin+k]; }
+    int expanded_of(uint32_t id)const noexcept;                    //已经分配了下标的子边数（子节点可能仍在发布中）
+    uint32_t child(uint32_t id,uint8_t move)const noexcept;        //落子move对应的已扩展子节点，没有时返回0
+    std::atomic<uint32_t>& edge_visit(uint32_t id,int k) noexcept{ return pool().edge_visits[pool().nodes[id].edge_begin+k]; }   //边统计只在开启置换时存在
+    std::atomic<int32_t>& edge_win(uint32_t id,int k) noexcept{ return pool().edge_wins[pool().nodes[id].edge_begin+k]; }
+    uint32_t edge_visit(uint32_t id,int k)const noexcept{ return pool().edge_visits[pool().nodes[id].edge_begin+k].load(std::memory_order_relaxed); }
+    std::atomic<uint32_t>& amaf_visit(uint32_t id,int k) noexcept{ return pool().amaf_visits[pool().nodes[id].edge_begin+k]; }   //AMAF统计只在开启AMAF时存在
+    std::atomic<int32_t>& amaf_win(uint32_t id,int k) noexcept{ return pool().amaf_wins[pool().nodes[id].edge_begin+k]; }
+    uint32_t amaf_visit(uint32_t id,int k)const noexcept{ return pool().amaf_visits[pool().nodes[id].edge_begin+k].load(std::memory_order_relaxed); }
+    int32_t amaf_win(uint32_t id,int k)const noexcept{ return pool().amaf_wins[pool().nodes[id].edge_begin+k].load(std::memory_order_relaxed); }
+    void swap_unexpanded(uint32_t id,int a,int b) noexcept;        //交换两条尚未扩展的子边连同边上的统计，调用者须持有节点的picking锁
+    uint32_t child_visits(uint32_t id,int k)const noexcept;        //经由第k条边的访问次数：开启置换时取边统计，否则就是子节点的访问次数
+    int32_t child_wins(uint32_t id,int k)const noexcept;           //经由第k条边的胜负累计，取法同上
+
+    uint32_t root() const noexcept{ return root_id; }
+    uint64_t root_key() const noexcept{ return root_zobrist; }     //根节点局面的Zobrist键
+    std::size_t node_count() const noexcept;                       //池中已分配的节点数，含reroot后尚未整理回收的节点
+    std::size_t bytes_used() const noexcept;                       //节点池和边池实际占用的字节数
+    double bytes_per_node() const noexcept;
+
+    static uint8_t edge_move(uint32_t edge) noexcept{ return static_cast<uint8_t>(edge&0xFFu); }
+    static uint32_t edge_child(uint32_t edge) noexcept{ return edge>>8; }
+    static uint32_t make_edge(uint8_t move,uint32_t child) noexcept{ return (child<<8)|move; }
+
+    static constexpr std::size_t DEFAULT_NODE_CAPACITY=1<<20;
+    static constexpr std::size_t DEFAULT_EDGE_CAPACITY=1<<22;
+    static constexpr std::size_t EDGES_PER_NODE=DEFAULT_EDGE_CAPACITY/DEFAULT_NODE_CAPACITY;
+    static std::size_t bytes_per_capacity(bool transpositions,bool amaf=false) noexcept;   //每单位节点容量（连同相应的边容量）最多占用的字节数，用于按内存预算换算容量
+    static constexpr std::size_t MAX_NODES=1u<<24;                 //子节点下标只有24位
+
+    enum : uint8_t { EDGES_NONE=0,EDGES_BUILDING=1,EDGES_READY=2 };   //TreeNode::state的取值
+
+private:
+    struct Arena{
+        TreeNode* nodes=nullptr;                //只分配内存，节点在new_node时才构造，未用到的部分不占物理内存
+        std::atomic<uint32_t>* edges=nullptr;
+        std::atomic<uint32_t>* edge_visits=nullptr;     //以下三项只在开启置换时分配
+        std::atomic<int32_t>* edge_wins=nullptr;
+        uint64_t* keys=nullptr;                         //每个节点局面的Zobrist键，0表示不在置换表中
+        std::atomic<uint32_t>* amaf_visits=nullptr;     //以下两项只在开启AMAF时分配
+        std::atomic<int32_t>* amaf_wins=nullptr;
+        std::atomic<uint32_t> node_top{0};
+        std::atomic<uint32_t> edge_top{0};
+    };
+
+    Arena& pool() noexcept{ return arenas[active]; }
+    const Arena& pool() const noexcept{ return arenas[active]; }
+    void allocate(Arena& arena);
+    void allocate_transpositions(Arena& arena);
+    void allocate_amaf(Arena& arena);
+    static void release(Arena& arena);
+    bool insert(const uint64_t* keys,uint32_t id,uint64_t key,uint32_t& existing) noexcept;   //登记节点（keys为节点所在池的键），键已被其他节点占用时返回false并给出该节点
+    void clear_table(const Arena& arena) noexcept;                        //从置换表中删去arena里登记过的节点
+    static void copy_node(TreeNode& to,const TreeNode& from,uint32_t parent);   //复制统计信息，不含子边
+    void copy_reachable(uint32_t min_visits);                   //compact和evict的实现，访问次数不到min_visits的子树不复制
+
+    Arena arenas[2];                            //当前使用的池和reroot时的备用池，轮换使用避免每步重新分配
+    int active;
+    std::size_t node_capacity;
+    std::size_t edge_capacity;
+    uint32_t root_id;
+    uint64_t root_zobrist;
+    bool dag;
+    bool amaf_stats;
+
+    //开放寻址的置换表，槽里存节点下标，键放在Arena::keys里；插入只需对空槽做一次CAS
+    std::atomic<uint32_t>* table=nullptr;
+    std::size_t table_mask=0;
+
+    std::vector<uint32_t> remap;                //compact时新下标对应的旧下标
+    std::vector<uint32_t> renumber;             //compact时旧下标对应的新下标，置换后一个节点可能有多条入边
+
+};
+
+//一次选择经过的路径：node[0]是根，node[i]经由node[i-1]的第slot[i]条边到达
+//有了置换，节点的父节点不唯一，反向传播沿这条路径而不是parent进行
+struct SearchPath{
+    static constexpr int MAX_DEPTH=BOARD_ROWS*BOARD_COLS+1;
+    uint32_t node[MAX_DEPTH];
+    uint8_t slot[MAX_DEPTH];
+    int depth=0;
+
+    void reset(uint32_t root) noexcept{ node[0]=root; depth=1; }
+    void push(uint32_t id,int k) noexcept{ node[depth]=id; slot[depth]=static_cast<uint8_t>(k); depth++; }
+    uint32_t leaf() const noexcept{ return node[depth-1]; }
+};
+
+#endif // SEARCHTREE_H
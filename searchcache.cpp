@@ -0,0 +1,158 @@
+#include "searchCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+static constexpr char CACHE_MAGIC[8]={'G','M','K','C','A','C','H','1'};
+static constexpr uint32_t CACHE_VERSION=1;
+static constexpr uint64_t BLACK_TO_MOVE=0x9E3779B97F4A7C15ull;
+static constexpr uint64_t WHITE_TO_MOVE=0xD1B54A32D192ED03ull;
+
+static std::size_t bucket_of(uint64_t key,std::size_t mask) noexcept{
+    return static_cast<std::size_t>(key^(key>>32))&mask;
+}
+
+//组相联插入：同一局面保留访问次数多的，桶满时挤掉访问次数最少的
+static void place(CacheEntry* table,std::size_t mask,const CacheEntry& entry) noexcept{
+    CacheEntry* bucket=table+bucket_of(entry.key,mask)*CACHE_WAYS;
+    CacheEntry* victim=bucket;
+    for(int w=0;w<CACHE_WAYS;w++){
+        if(bucket[w].key==entry.key){
+            if(bucket[w].visits<entry.visits) bucket[w]=entry;
+            return;
+        }
+        if(bucket[w].key==0){
+            bucket[w]=entry;
+            return;
+        }
+        if(bucket[w].visits<victim->visits) victim=&bucket[w];
+    }
+    if(victim->visits<entry.visits) *victim=entry;
+}
+
+SearchCache::~SearchCache(){
+    Close();
+}
+
+uint64_t SearchCache::Key(uint64_t zobrist,Player player) noexcept{
+    return zobrist^((player==Player::White)? WHITE_TO_MOVE:BLACK_TO_MOVE);
+}
+
+bool SearchCache::Open(const std::string& path,const SearchCacheOptions& options){
+    Close();
+    if(path.empty()) return false;
+    if(file.Open(path)){
+        const CacheHeader* header=static_cast<const CacheHeader*>(file.Data());
+        if(file.Size()<sizeof(CacheHeader)||std::memcmp(header->magic,CACHE_MAGIC,sizeof(CACHE_MAGIC))!=0||header->version!=CACHE_VERSION||
+           header->buckets==0||(header->buckets&(header->buckets-1))!=0||
+           file.Size()!=sizeof(CacheHeader)+static_cast<std::size_t>(header->buckets)*CACHE_WAYS*sizeof(CacheEntry)){
+            file.Close();
+            return false;
+        }
+        table=reinterpret_cast<const CacheEntry*>(static_cast<const char*>(file.Data())+sizeof(CacheHeader));
+        bucket_mask=header->buckets-1;
+    }
+    this->path=path;
+    this->options=options;
+    this->options.capacity=std::max<std::size_t>(options.capacity,CACHE_WAYS);
+    this->options.max_prior=std::max<uint32_t>(options.max_prior,1);
+    return true;
+}
+
+void SearchCache::Close(){
+    if(!IsOpen()) return;
+    Flush();
+    reload();
+    file.Close();
+    table=nullptr;
+    bucket_mask=0;
+    path.clear();
+}
+
+std::size_t SearchCache::Size() const noexcept{
+    if(table==nullptr) return 0;
+    std::size_t count=0;
+    for(std::size_t i=0;i<(bucket_mask+1)*CACHE_WAYS;i++){
+        if(table[i].key!=0) count++;
+    }
+    return count;
+}
+
+const CacheEntry* SearchCache::find(uint64_t key) const noexcept{
+    if(table==nullptr) return nullptr;
+    const CacheEntry* bucket=table+bucket_of(key,bucket_mask)*CACHE_WAYS;
+    for(int w=0;w<CACHE_WAYS;w++){
+        if(bucket[w].key==key) return &bucket[w];
+    }
+    return nullptr;
+}
+
+bool SearchCache::Prior(uint64_t key,uint32_t& visits,int32_t& wins) const noexcept{
+    const CacheEntry* entry=find(key);
+    if(entry==nullptr||entry->visits==0) return false;
+    visits=std::min(entry->visits,options.max_prior);
+    wins=static_cast<int32_t>(std::lround(static_cast<double>(entry->wins)*visits/entry->visits));
+    return true;
+}
+
+void SearchCache::Record(uint64_t key,uint32_t visits,int32_t wins){
+    if(!IsOpen()||visits<options.min_visits) return;
+    CacheEntry& entry=pending[key];
+    if(entry.key==0||entry.visits<visits) entry=CacheEntry{key,visits,wins};
+}
+
+void SearchCache::Flush(){
+    if(!IsOpen()) return;
+    reload();                   //后台线程只读当前映射，上一次的结果必须先换上，否则会丢掉它写入的记录
+    if(pending.empty()) return;
+    writer=std::thread([this,records=std::move(pending)]() mutable{
+        written=write(std::move(records));
+    });
+    pending.clear();
+}
+
+void SearchCache::reload(){
+    if(!writer.joinable()) return;
+    writer.join();
+    if(!written) return;
+    written=false;
+    file.Close();               //Windows上映射着的文件不能被替换
+    table=nullptr;
+    bucket_mask=0;
+    MappedFile::Replace(path+".tmp",path);
+    if(!file.Open(path)) return;
+    const CacheHeader* header=static_cast<const CacheHeader*>(file.Data());
+    table=reinterpret_cast<const CacheEntry*>(static_cast<const char*>(file.Data())+sizeof(CacheHeader));
+    bucket_mask=header->buckets-1;
+}
+
+bool SearchCache::write(std::unordered_map<uint64_t,CacheEntry> records) const{
+    std::size_t buckets=1;
+    while(buckets*2*CACHE_WAYS<=options.capacity) buckets*=2;
+    std::vector<CacheEntry> merged(buckets*CACHE_WAYS,CacheEntry{0,0,0});
+    std::size_t mask=buckets-1;
+    if(table!=nullptr){                 //容量改变时旧表按新的桶数重新散列
+        for(std::size_t i=0;i<(bucket_mask+1)*CACHE_WAYS;i++){
+            if(table[i].key!=0) place(merged.data(),mask,table[i]);
+        }
+    }
+    for(const auto& item : records){
+        place(merged.data(),mask,item.second);
+    }
+
+    std::string temp=path+".tmp";
+    std::FILE* out=std::fopen(temp.c_str(),"wb");
+    if(out==nullptr) return false;
+    CacheHeader header;
+    std::memcpy(header.magic,CACHE_MAGIC,sizeof(CACHE_MAGIC));
+    header.version=CACHE_VERSION;
+    header.buckets=static_cast<uint32_t>(buckets);
+    bool ok=std::fwrite(&header,sizeof(header),1,out)==1&&
+            std::fwrite(merged.data(),sizeof(CacheEntry),merged.size(),out)==merged.size();
+    ok=(std::fclose(out)==0)&&ok;
+    if(!ok) std::remove(temp.c_str());
+    return ok;
+}
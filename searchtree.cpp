@@ -0,0 +1,462 @@
+#include "searchTree.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+SearchTree::SearchTree(std::size_t node_capacity,std::size_t edge_capacity)
+    : active(0),node_capacity(std::min(node_capacity,MAX_NODES)),edge_capacity(edge_capacity),dag(false),amaf_stats(false){
+    allocate(arenas[0]);
+    clear(Player::None,0);
+}
+
+SearchTree::~SearchTree(){
+    release(arenas[0]);
+    release(arenas[1]);
+    ::operator delete(table);
+}
+
+void SearchTree::resize(std::size_t node_capacity,std::size_t edge_capacity){
+    node_capacity=std::min(std::max<std::size_t>(node_capacity,2),MAX_NODES);
+    edge_capacity=std::max<std::size_t>(edge_capacity,BOARD_ROWS*BOARD_COLS);
+    if(node_capacity==this->node_capacity&&edge_capacity==this->edge_capacity) return;
+    bool on=dag,amaf_on=amaf_stats;
+    if(dag) clear_table(pool());
+    release(arenas[0]);
+    release(arenas[1]);
+    ::operator delete(table);
+    table=nullptr;
+    table_mask=0;
+    dag=false;
+    amaf_stats=false;
+    active=0;
+    this->node_capacity=node_capacity;
+    this->edge_capacity=edge_capacity;
+    allocate(arenas[0]);
+    set_transpositions(on);         //置换表的大小随节点容量变化
+    set_amaf(amaf_on);
+    clear(Player::None,0);
+}
+
+std::size_t SearchTree::bytes_per_capacity(bool transpositions,bool amaf) noexcept{
+    std::size_t per_arena=sizeof(TreeNode)+EDGES_PER_NODE*sizeof(uint32_t);
+    if(transpositions) per_arena+=sizeof(uint64_t)+EDGES_PER_NODE*2*sizeof(uint32_t);
+    if(amaf) per_arena+=EDGES_PER_NODE*2*sizeof(uint32_t);
+    return 2*per_arena+(transpositions? 4*sizeof(uint32_t):0);     //两个池轮换，置换表按节点数的2到4倍取2的幂
+}
+
+bool SearchTree::nearly_full() const noexcept{
+    return pool().node_top.load(std::memory_order_relaxed)>=node_capacity/8*7||
+           pool().edge_top.load(std::memory_order_relaxed)>=edge_capacity/8*7;
+}
+
+void SearchTree::set_transpositions(bool on){
+    if(on==dag) return;
+    if(on&&table==nullptr){
+        std::size_t size=1;
+        while(size<2*node_capacity) size<<=1;            //装载率不超过一半，线性探测的平均探测次数很短
+        table=static_cast<std::atomic<uint32_t>*>(::operator new(size*sizeof(std::atomic<uint32_t>)));
+        for(std::size_t i=0;i<size;i++){
+            new (&table[i]) std::atomic<uint32_t>(NULL_NODE);
+        }
+        table_mask=size-1;
+    }
+    if(on){
+        allocate_transpositions(arenas[active]);
+    }
+    else if(pool().keys!=nullptr){
+        clear_table(pool());
+    }
+    dag=on;
+}
+
+void SearchTree::allocate_transpositions(Arena& arena){
+    if(arena.keys!=nullptr) return;
+    arena.edge_visits=static_cast<std::atomic<uint32_t>*>(::operator new(edge_capacity*sizeof(std::atomic<uint32_t>)));
+    arena.edge_wins=static_cast<std::atomic<int32_t>*>(::operator new(edge_capacity*sizeof(std::atomic<int32_t>)));
+    arena.keys=static_cast<uint64_t*>(::operator new(node_capacity*sizeof(uint64_t)));
+    std::memset(static_cast<void*>(arena.keys),0,node_capacity*sizeof(uint64_t));   //未登记的节点不能被clear_table误删
+}
+
+void SearchTree::set_amaf(bool on){
+    if(on) allocate_amaf(arenas[active]);
+    amaf_stats=on;
+}
+
+void SearchTree::allocate_amaf(Arena& arena){
+    if(arena.amaf_visits!=nullptr) return;
+    arena.amaf_visits=static_cast<std::atomic<uint32_t>*>(::operator new(edge_capacity*sizeof(std::atomic<uint32_t>)));
+    arena.amaf_wins=static_cast<std::atomic<int32_t>*>(::operator new(edge_capacity*sizeof(std::atomic<int32_t>)));
+}
+
+void SearchTree::allocate(Arena& arena){
+    if(arena.nodes!=nullptr) return;
+    arena.nodes=static_cast<TreeNode*>(::operator new(node_capacity*sizeof(TreeNode)));
+    arena.edges=static_cast<std::atomic<uint32_t>*>(::operator new(edge_capacity*sizeof(std::atomic<uint32_t>)));
+}
+
+void SearchTree::release(Arena& arena){
+    ::operator delete(arena.nodes);
+    ::operator delete(arena.edges);
+    ::operator delete(arena.edge_visits);
+    ::operator delete(arena.edge_wins);
+    ::operator delete(arena.keys);
+    ::operator delete(arena.amaf_visits);
+    ::operator delete(arena.amaf_wins);
+    arena.nodes=nullptr;
+    arena.edges=nullptr;
+    arena.edge_visits=nullptr;
+    arena.edge_wins=nullptr;
+    arena.keys=nullptr;
+    arena.amaf_visits=nullptr;
+    arena.amaf_wins=nullptr;
+}
+
+void SearchTree::clear(Player player,uint64_t key){
+    if(dag) clear_table(pool());
+    pool().node_top.store(0,std::memory_order_relaxed);
+    pool().edge_top.store(0,std::memory_order_relaxed);
+    root_id=new_node(NULL_NODE,NO_MOVE,player);
+    root_zobrist=key;
+}
+
+bool SearchTree::insert(const uint64_t* keys,uint32_t id,uint64_t key,uint32_t& existing) noexcept{
+    for(std::size_t i=key&table_mask,probes=0;probes<=table_mask;i=(i+1)&table_mask,probes++){
+        uint32_t slot=table[i].load(std::memory_order_acquire);
+        if(slot==NULL_NODE){
+            if(table[i].compare_exchange_strong(slot,id,std::memory_order_acq_rel)) return true;
+        }
+        if(keys[slot]==key){            //CAS失败时slot已是抢先登记的节点
+            existing=slot;
+            return false;
+        }
+    }
+    existing=NULL_NODE;                 //表已满，节点照常使用但不参与置换
+    return false;
+}
+
+void SearchTree::clear_table(const Arena& arena) noexcept{
+    //只清理登记过的槽而不是整张表；删除不保持探测链，但所有节点都要删，按下标找到自己的槽即可
+    uint32_t top=std::min<uint32_t>(arena.node_top.load(std::memory_order_relaxed),static_cast<uint32_t>(node_capacity));
+    for(uint32_t id=0;id<top;id++){
+        uint64_t key=arena.keys[id];
+        if(key==0) continue;
+        for(std::size_t i=key&table_mask;;i=(i+1)&table_mask){
+            if(table[i].load(std::memory_order_relaxed)==id){
+                table[i].store(NULL_NODE,std::memory_order_relaxed);
+                break;
+            }
+        }
+        arena.keys[id]=0;
+    }
+}
+
+uint32_t SearchTree::find_or_add(uint32_t parent,uint8_t move,Player player,Proof proof,uint64_t key,uint32_t prior_visits,int32_t prior_wins){
+    if(dag){
+        const uint64_t* keys=pool().keys;
+        for(std::size_t i=key&table_mask,probes=0;probes<=table_mask;i=(i+1)&table_mask,probes++){   //先查一遍，命中时不必分配
+            uint32_t slot=table[i].load(std::memory_order_acquire);
+            if(slot==NULL_NODE) break;
+            if(keys[slot]==key) return slot;
+        }
+    }
+    uint32_t id=new_node(parent,move,player);
+    if(id==NULL_NODE) return NULL_NODE;
+    pool().nodes[id].proof.store(proof,std::memory_order_relaxed);      //登记前写好，其他线程经置换表拿到的节点已完整
+    pool().nodes[id].visit.store(prior_visits,std::memory_order_relaxed);
+    pool().nodes[id].win.store(prior_wins,std::memory_order_relaxed);
+    if(dag){
+        pool().keys[id]=key;
+        uint32_t existing;
+        if(!insert(pool().keys,id,key,existing)){
+            pool().keys[id]=0;              //与另一个线程同时创建了同一局面，本节点作废
+            if(existing!=NULL_NODE) return existing;
+        }
+    }
+    return id;
+}
+
+uint32_t SearchTree::child_visits(uint32_t id,int k)const noexcept{
+    if(dag) return edge_visit(id,k);
+    uint32_t child=edge_child(pool().edges[pool().nodes[id].edge_begin+k].load(std::memory_order_acquire));
+    return child==0? 0:pool().nodes[child].visit.load(std::memory_order_relaxed);
+}
+
+int32_t SearchTree::child_wins(uint32_t id,int k)const noexcept{
+    if(dag) return pool().edge_wins[pool().nodes[id].edge_begin+k].load(std::memory_order_relaxed);
+    uint32_t child=edge_child(pool().edges[pool().nodes[id].edge_begin+k].load(std::memory_order_acquire));
+    return child==0? 0:pool().nodes[child].win.load(std::memory_order_relaxed);
+}
+
+void SearchTree::swap_unexpanded(uint32_t id,int a,int b) noexcept{
+    //尚未扩展的边只有持锁的线程会改写；其他线程此时回传到这两条边上的统计可能有少量落在交换前的位置，只影响估值不影响正确性
+    Arena& arena=pool();
+    uint32_t i=arena.nodes[id].edge_begin+a,j=arena.nodes[id].edge_begin+b;
+    auto swap=[](auto* array,uint32_t i,uint32_t j){
+        auto value=array[i].load(std::memory_order_relaxed);
+        array[i].store(array[j].load(std::memory_order_relaxed),std::memory_order_relaxed);
+        array[j].store(value,std::memory_order_relaxed);
+    };
+    swap(arena.edges,i,j);
+    if(dag){
+        swap(arena.edge_visits,i,j);
+        swap(arena.edge_wins,i,j);
+    }
+    if(amaf_stats){
+        swap(arena.amaf_visits,i,j);
+        swap(arena.amaf_wins,i,j);
+    }
+}
+
+uint32_t SearchTree::new_node(uint32_t parent,uint8_t move,Player player){
+    Arena& arena=pool();
+    if(arena.node_top.load(std::memory_order_relaxed)>=node_capacity) return NULL_NODE;
+    uint32_t id=arena.node_top.fetch_add(1,std::memory_order_relaxed);
+    if(id>=node_capacity) return NULL_NODE;
+    TreeNode* node=new (&arena.nodes[id]) TreeNode();
+    node->parent=parent;
+    node->move=move;
+    node->player=player;
+    return id;
+}
+
+bool SearchTree::init_edges(uint32_t node,const uint8_t* moves,int num,bool all_moves){
+    Arena& arena=pool();
+    TreeNode& n=arena.nodes[node];
+    uint8_t expected=EDGES_NONE;
+    if(!n.state.compare_exchange_strong(expected,EDGES_BUILDING,std::memory_order_acquire)) return false;
+    if(arena.edge_top.load(std::memory_order_relaxed)+num>edge_capacity){
+        n.state.store(EDGES_NONE,std::memory_order_release);     //边池已满，节点保持为叶子
+        return false;
+    }
+    uint32_t begin=arena.edge_top.fetch_add(num,std::memory_order_relaxed);
+    if(begin+num>edge_capacity){
+        n.state.store(EDGES_NONE,std::memory_order_release);
+        return false;
+    }
+    for(int i=0;i<num;i++){
+        arena.edges[begin+i].store(make_edge(moves[i],0),std::memory_order_relaxed);
+    }
+    if(dag){
+        for(int i=0;i<num;i++){
+            new (&arena.edge_visits[begin+i]) std::atomic<uint32_t>(0);
+            new (&arena.edge_wins[begin+i]) std::atomic<int32_t>(0);
+        }
+    }
+    if(amaf_stats){
+        for(int i=0;i<num;i++){
+            new (&arena.amaf_visits[begin+i]) std::atomic<uint32_t>(0);
+            new (&arena.amaf_wins[begin+i]) std::atomic<int32_t>(0);
+        }
+    }
+    n.edge_begin.store(begin,std::memory_order_relaxed);
+    n.edge_num.store(static_cast<uint8_t>(num),std::memory_order_relaxed);
+    n.all_moves.store(all_moves,std::memory_order_relaxed);
+    n.state.store(EDGES_READY,std::memory_order_release);       //发布之后其他线程才能读edge_begin/edge_num
+    return true;
+}
+
+bool SearchTree::widen_edges(uint32_t node,const uint8_t* moves,int num){
+    //原有的边连同统计按原下标复制到边池的新位置，新落子接在后面，然后先改edge_begin再改edge_num：
+    //读到新edge_num的线程之后读到的一定是新edge_begin，仍按旧edge_num访问的线程在新旧两处看到的边相同。
+    //复制之后其他线程回传到旧位置的少量统计会丢失，只影响估值不影响正确性
+    Arena& arena=pool();
+    TreeNode& n=arena.nodes[node];
+    int old=n.edge_num,total=old+num;
+    if(arena.edge_top.load(std::memory_order_relaxed)+total>edge_capacity) return false;
+    uint32_t begin=arena.edge_top.fetch_add(total,std::memory_order_relaxed);
+    if(begin+total>edge_capacity) return false;
+    uint32_t from=n.edge_begin;
+    for(int i=0;i<total;i++){
+        uint32_t e=(i<old)? arena.edges[from+i].load(std::memory_order_acquire):make_edge(moves[i-old],0);
+        arena.edges[begin+i].store(e,std::memory_order_relaxed);
+    }
+    if(dag){
+        for(int i=0;i<total;i++){
+            new (&arena.edge_visits[begin+i]) std::atomic<uint32_t>((i<old)? arena.edge_visits[from+i].load(std::memory_order_relaxed):0);
+            new (&arena.edge_wins[begin+i]) std::atomic<int32_t>((i<old)? arena.edge_wins[from+i].load(std::memory_order_relaxed):0);
+        }
+    }
+    if(amaf_stats){
+        for(int i=0;i<total;i++){
+            new (&arena.amaf_visits[begin+i]) std::atomic<uint32_t>((i<old)? arena.amaf_visits[from+i].load(std::memory_order_relaxed):0);
+            new (&arena.amaf_wins[begin+i]) std::atomic<int32_t>((i<old)? arena.amaf_wins[from+i].load(std::memory_order_relaxed):0);
+        }
+    }
+    n.expanded.store(static_cast<uint16_t>(old),std::memory_order_relaxed);    //领取失败的线程可能让它超过了old
+    n.all_moves.store(true,std::memory_order_relaxed);
+    n.edge_begin.store(begin);
+    n.edge_num.store(static_cast<uint8_t>(total));
+    return true;
+}
+
+int SearchTree::expanded_of(uint32_t id)const noexcept{
+    const TreeNode& n=pool().nodes[id];
+    return std::min<int>(n.expanded.load(std::memory_order_acquire),n.edge_num);
+}
+
+uint32_t SearchTree::child(uint32_t id,uint8_t move)const noexcept{
+    const Arena& arena=pool();
+    const TreeNode& n=arena.nodes[id];
+    if(n.state.load(std::memory_order_acquire)!=EDGES_READY) return 0;
+    for(int i=0;i<expanded_of(id);i++){
+        uint32_t e=arena.edges[n.edge_begin+i].load(std::memory_order_relaxed);
+        if(edge_move(e)==move) return edge_child(e);
+    }
+    return 0;
+}
+
+void SearchTree::reroot(uint8_t move,Player player,uint64_t key){
+    Arena& from=pool();
+    uint32_t keep=child(root_id,move);
+    if(keep==0){
+        clear(player,key);      //新局面不在树里，直接重建
+        return;
+    }
+
+    //原地提升：保留的子节点直接成为根，兄弟子树和旧根留在池里不再可达，代价与丢弃的节点数无关
+    TreeNode& promoted=from.nodes[keep];
+    promoted.parent=NULL_NODE;
+    promoted.move=NO_MOVE;
+    root_id=keep;
+    root_zobrist=key;
+    if(from.node_top.load(std::memory_order_relaxed)>=node_capacity/2||from.edge_top.load(std::memory_order_relaxed)>=edge_capacity/2){
+        compact();      //池用过一半后才整理一次，均摊到每步的代价只与保留的子树有关
+    }
+}
+
+void SearchTree::compact(){
+    copy_reachable(0);
+}
+
+std::size_t SearchTree::evict(){
+    //先遍历一遍可达的节点，按访问次数的二进制位数分档统计节点数和边数，
+    //再从访问最多的一档往下累加，找出能让两个池都降到一半以下的最低门槛
+    Arena& from=pool();
+    std::size_t nodes[33]={},edges[33]={};
+    remap.clear();
+    renumber.assign(node_count(),NULL_NODE);
+    remap.push_back(root_id);
+    renumber[root_id]=0;
+    for(std::size_t i=0;i<remap.size();i++){
+        const TreeNode& n=from.nodes[remap[i]];
+        uint32_t visit=n.visit.load(std::memory_order_relaxed);
+        int bucket=(visit==0)? 0:32-__builtin_clz(visit);
+        nodes[bucket]++;
+        if(n.state.load(std::memory_order_acquire)!=EDGES_READY) continue;
+        edges[bucket]+=n.edge_num;
+        for(int k=0;k<expanded_of(remap[i]);k++){
+            uint32_t child=edge_child(from.edges[n.edge_begin+k].load(std::memory_order_relaxed));
+            if(child==0||renumber[child]!=NULL_NODE) continue;
+            renumber[child]=0;
+            remap.push_back(child);
+        }
+    }
+    std::size_t reachable=remap.size();
+    int threshold=33;
+    std::size_t kept_nodes=0,kept_edges=0;
+    while(threshold>0&&kept_nodes+nodes[threshold-1]<=node_capacity/2&&kept_edges+edges[threshold-1]<=edge_capacity/2){
+        threshold--;
+        kept_nodes+=nodes[threshold];
+        kept_edges+=edges[threshold];
+    }
+    copy_reachable((threshold==0)? 0:(threshold>32)? UINT32_MAX:1u<<(threshold-1));     //第b档的访问次数在[2^(b-1),2^b)之间
+    return reachable-node_count();
+}
+
+void SearchTree::copy_reachable(uint32_t min_visits){
+    //按广度优先把根的子树复制到备用池里，下标重新编号，新根位于0号
+    //置换后一个节点可能有多条入边，用renumber保证每个节点只复制一次
+    //访问次数不到min_visits的子节点连同子树一起丢弃，指向它的边恢复为未扩展，以后可以重新扩展
+    Arena& from=pool();
+    Arena& to=arenas[1-active];
+    allocate(to);
+    if(dag) allocate_transpositions(to);
+    if(amaf_stats) allocate_amaf(to);
+    uint32_t node_top=0,edge_top=0;
+    remap.clear();
+    renumber.assign(std::min<std::size_t>(from.node_top.load(std::memory_order_relaxed),node_capacity),NULL_NODE);
+    remap.push_back(root_id);
+    renumber[root_id]=node_top;
+    copy_node(to.nodes[node_top++],from.nodes[root_id],NULL_NODE);
+    for(std::size_t i=0;i<remap.size();i++){
+        const TreeNode& old=from.nodes[remap[i]];
+        if(dag) to.keys[i]=from.keys[remap[i]];
+        if(old.state.load(std::memory_order_acquire)!=EDGES_READY) continue;
+        TreeNode& copy=to.nodes[i];
+        copy.edge_begin.store(edge_top,std::memory_order_relaxed);
+        copy.edge_num.store(old.edge_num,std::memory_order_relaxed);
+        copy.all_moves.store(old.all_moves,std::memory_order_relaxed);
+        int expanded=0;
+        auto copy_edge=[&](int k,uint32_t e,bool pruned){
+            uint32_t at=edge_top+expanded++;
+            to.edges[at].store(e,std::memory_order_relaxed);
+            if(dag){            //被剪掉的边统计清零
+                new (&to.edge_visits[at]) std::atomic<uint32_t>(pruned? 0:from.edge_visits[old.edge_begin+k].load(std::memory_order_relaxed));
+                new (&to.edge_wins[at]) std::atomic<int32_t>(pruned? 0:from.edge_wins[old.edge_begin+k].load(std::memory_order_relaxed));
+            }
+            if(amaf_stats){     //AMAF统计属于落子而不是子树，剪掉的边也保留
+                new (&to.amaf_visits[at]) std::atomic<uint32_t>(from.amaf_visits[old.edge_begin+k].load(std::memory_order_relaxed));
+                new (&to.amaf_wins[at]) std::atomic<int32_t>(from.amaf_wins[old.edge_begin+k].load(std::memory_order_relaxed));
+            }
+        };
+        auto pruned=[&](uint32_t child){ return from.nodes[child].visit.load(std::memory_order_relaxed)<min_visits; };
+        for(int k=0;k<old.edge_num;k++){             //已有子节点的边排在前面
+            uint32_t e=from.edges[old.edge_begin+k].load(std::memory_order_relaxed);
+            uint32_t child=edge_child(e);
+            if(child==0||pruned(child)) continue;
+            if(renumber[child]==NULL_NODE){
+                renumber[child]=node_top;
+                copy_node(to.nodes[node_top++],from.nodes[child],static_cast<uint32_t>(i));
+                remap.push_back(child);
+            }
+            copy_edge(k,make_edge(edge_move(e),renumber[child]),false);
+        }
+        copy.expanded.store(static_cast<uint16_t>(expanded),std::memory_order_relaxed);
+        for(int k=0;k<old.edge_num;k++){
+            uint32_t e=from.edges[old.edge_begin+k].load(std::memory_order_relaxed);
+            if(edge_child(e)==0) copy_edge(k,e,false);
+            else if(pruned(edge_child(e))) copy_edge(k,make_edge(edge_move(e),0),true);
+        }
+        copy.state.store(EDGES_READY,std::memory_order_relaxed);
+        edge_top+=old.edge_num;
+    }
+    if(dag){
+        clear_table(from);          //旧池的登记全部作废，再登记新池里除根以外的节点
+        to.keys[0]=0;
+        for(uint32_t id=1;id<node_top;id++){
+            uint32_t existing;
+            if(to.keys[id]!=0&&!insert(to.keys,id,to.keys[id],existing)) to.keys[id]=0;
+        }
+    }
+    to.node_top.store(node_top,std::memory_order_relaxed);
+    to.edge_top.store(edge_top,std::memory_order_relaxed);
+    active=1-active;
+    root_id=0;
+}
+
+void SearchTree::copy_node(TreeNode& to,const TreeNode& from,uint32_t parent){
+    new (&to) TreeNode();
+    to.win.store(from.win.load(std::memory_order_relaxed),std::memory_order_relaxed);
+    to.visit.store(from.visit.load(std::memory_order_relaxed),std::memory_order_relaxed);
+    to.parent=parent;
+    to.move=from.move;
+    to.player=from.player;
+    to.proof.store(from.proof.load(std::memory_order_relaxed),std::memory_order_relaxed);
+}
+
+std::size_t SearchTree::node_count() const noexcept{
+    return std::min<std::size_t>(pool().node_top.load(std::memory_order_relaxed),node_capacity);
+}
+
+std::size_t SearchTree::bytes_used() const noexcept{
+    std::size_t edges=std::min<std::size_t>(pool().edge_top.load(std::memory_order_relaxed),edge_capacity);
+    std::size_t per_edge=sizeof(uint32_t)+(amaf_stats? 2*sizeof(uint32_t):0);
+    if(dag) return node_count()*(sizeof(TreeNode)+sizeof(uint64_t))+edges*(per_edge+2*sizeof(uint32_t));      //另有节点的键和边的两项统计
+    return node_count()*sizeof(TreeNode)+edges*per_edge;
+}
+
+double SearchTree::bytes_per_node() const noexcept{
+    std::size_t nodes=node_count();
+    return nodes==0? 0.0:1.0*bytes_used()/nodes;
+}
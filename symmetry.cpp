@@ -0,0 +1,40 @@
+#include "symmetry.h"
+
+int compose_symmetry(int a,int b) noexcept{
+    //两个不对称的格子足以区分八种变换
+    constexpr int probe1=1,probe2=BOARD_COLS*2;
+    int want1=transform_cell(transform_cell(probe1,b),a),want2=transform_cell(transform_cell(probe2,b),a);
+    for(int t=0;t<SYMMETRIES;t++){
+        if(transform_cell(probe1,t)==want1&&transform_cell(probe2,t)==want2) return t;
+    }
+    return 0;       //不会到达
+}
+
+ChessBoard transform_board(const ChessBoard& board,int t) noexcept{
+    if(t==0) return board;
+    ChessBoard result;
+    for(int cell=0;cell<BOARD_ROWS*BOARD_COLS;cell++){
+        int to=transform_cell(cell,t);
+        result.grid[to/BOARD_COLS][to%BOARD_COLS]=board.grid[cell/BOARD_COLS][cell%BOARD_COLS];
+    }
+    return result;
+}
+
+uint8_t invariant_symmetries(const ChessBoard& board) noexcept{
+    //只需检查每个棋子的像是否是同色棋子：变换是双射，棋子数相同，全部对上就是同一局面
+    uint8_t stones[BOARD_ROWS*BOARD_COLS];
+    int n=0;
+    for(int cell=0;cell<BOARD_ROWS*BOARD_COLS;cell++){
+        if(board.grid[cell/BOARD_COLS][cell%BOARD_COLS]!=Player::None) stones[n++]=static_cast<uint8_t>(cell);
+    }
+    uint8_t mask=0;
+    for(int t=1;t<SYMMETRIES;t++){
+        bool same=true;
+        for(int k=0;k<n&&same;k++){         //一般局面在前几个棋子处就对不上，提前退出
+            int to=transform_cell(stones[k],t);
+            same=board.grid[to/BOARD_COLS][to%BOARD_COLS]==board.grid[stones[k]/BOARD_COLS][stones[k]%BOARD_COLS];
+        }
+        if(same) mask|=static_cast<uint8_t>(1u<<t);
+    }
+    return mask;
+}
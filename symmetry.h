@@ -0,0 +1,55 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "config.h"
+#include <array>
+#include <cstdint>
+
+static_assert(BOARD_ROWS==BOARD_COLS,"八种对称变换要求棋盘是正方形");
+
+//棋盘的八种对称变换（二面体群D4）：0是恒等，1/2/3依次旋转90/180/270度，4~7是左右、上下、主对角线、副对角线翻转
+//开局库用它把局面规范化，搜索用它合并对称局面下等价的候选落子
+constexpr int SYMMETRIES=8;
+
+using SymmetryTable=std::array<std::array<uint8_t,BOARD_ROWS*BOARD_COLS>,SYMMETRIES>;
+
+constexpr SymmetryTable make_symmetry_table(){
+    SymmetryTable table{};
+    constexpr int N=BOARD_ROWS-1;
+    for(int r=0;r<BOARD_ROWS;r++){
+        for(int c=0;c<BOARD_COLS;c++){
+            int to[SYMMETRIES][2]={{r,c},{c,N-r},{N-r,N-c},{N-c,r},{r,N-c},{N-r,c},{c,r},{N-c,N-r}};
+            for(int t=0;t<SYMMETRIES;t++){
+                table[t][r*BOARD_COLS+c]=static_cast<uint8_t>(to[t][0]*BOARD_COLS+to[t][1]);
+            }
+        }
+    }
+    return table;
+}
+
+inline constexpr SymmetryTable SYMMETRY=make_symmetry_table();
+
+inline int transform_cell(int cell,int t) noexcept{         //对格子施加第t种变换
+    return SYMMETRY[t][cell];
+}
+
+inline int inverse_symmetry(int t) noexcept{               //旋转90与270互逆，其余都是自身的逆
+    constexpr int inverse[SYMMETRIES]={0,3,2,1,4,5,6,7};
+    return inverse[t];
+}
+
+int compose_symmetry(int a,int b) noexcept;                     //先做b再做a等价的单个变换
+ChessBoard transform_board(const ChessBoard& board,int t) noexcept;
+uint8_t invariant_symmetries(const ChessBoard& board) noexcept;  //使局面保持不变的非恒等变换，第t位对应变换t
+
+//使格子cell保持不动的非恒等变换，掩码同上。对称局面落一子后，落子不动的那些变换仍使新局面不变，
+//所以沿搜索路径把根的掩码逐步与它求交，不必每个节点重新扫描整盘；落子新造出的对称不在其中，只是少合并一些候选落子
+inline uint8_t fixing_symmetries(int cell) noexcept{
+    uint8_t mask=0;
+    for(int t=1;t<SYMMETRIES;t++){
+        if(SYMMETRY[t][cell]==cell) mask|=static_cast<uint8_t>(1u<<t);
+    }
+    return mask;
+}
+
+#endif // SYMMETRY_H
@@ -0,0 +1,44 @@
+#include "telemetry.h"
+#include <cstdio>
+
+static const char* const PHASE_NAMES[PHASE_COUNT]={"heuristics","select","simulation","backup","reuse","evict"};
+
+const char* decision_name(Decision decision) noexcept{
+    switch(decision){
+    case Decision::Book: return "book";
+    case Decision::Four: return "four";
+    case Decision::Three: return "three";
+    case Decision::DoubleThree: return "double_three";
+    case Decision::Search: return "search";
+    case Decision::Solved: return "solved";
+    default: return "none";
+    }
+}
+
+void ThreadTelemetry::merge_into(MoveTelemetry& move) const noexcept{
+    for(int i=0;i<PHASE_COUNT;i++){
+        move.thread_seconds[i]+=seconds[i];
+    }
+    move.selects+=selects;
+    move.depth_sum+=depth_sum;
+    if(max_depth>move.max_depth) move.max_depth=max_depth;
+}
+
+std::string MoveTelemetry::ToJson() const{
+    char buffer[160];
+    std::string line;
+    std::snprintf(buffer,sizeof(buffer),"{\"move\": %d, \"row\": %d, \"col\": %d, \"decision\": \"%s\", \"playouts\": %lld, \"seconds\": %.6f, \"playouts_per_sec\": %.1f",
+                  move_number,row,col,decision_name(decision),playouts,seconds,seconds>0.0? playouts/seconds:0.0);
+    line+=buffer;
+    line+=", \"thread_seconds\": {";
+    for(int i=0;i<PHASE_COUNT;i++){
+        std::snprintf(buffer,sizeof(buffer),"%s\"%s\": %.6f",i==0? "":", ",PHASE_NAMES[i],thread_seconds[i]);
+        line+=buffer;
+    }
+    std::snprintf(buffer,sizeof(buffer),"}, \"depth\": {\"max\": %d, \"avg\": %.2f}, \"branching\": {\"max\": %d, \"avg\": %.2f}",
+                  max_depth,average_depth(),max_branching,average_branching());
+    line+=buffer;
+    std::snprintf(buffer,sizeof(buffer),", \"nodes\": %zu, \"tree_bytes\": %zu, \"table_slots\": %zu, \"table_load\": %.4f, \"evicted\": %zu}",nodes,tree_bytes,table_slots,table_load,evicted);
+    line+=buffer;
+    return line;
+}
@@ -0,0 +1,97 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//搜索遥测：每步的计数、各阶段耗时和树的形状
+//热路径上的采集都写在TELEMETRY(...)里，构建时不定义GOMOKU_TELEMETRY就整段消失，不留任何开销
+#ifdef GOMOKU_TELEMETRY
+#define TELEMETRY(...) __VA_ARGS__
+#else
+#define TELEMETRY(...)
+#endif
+
+enum class Phase{
+    Heuristics,   //开局库和根节点启发式
+    Select,       //选择与扩展
+    Simulation,   //推演
+    BackUp,       //反向传播
+    Reuse,        //落子后的节点复用（含整理）
+    Evict,        //等待和执行节点淘汰
+    Count
+};
+constexpr int PHASE_COUNT=static_cast<int>(Phase::Count);
+
+//这一步是怎么决定的
+enum class Decision{
+    None,
+    Book,          //开局库
+    Four,          //己方成五或挡对方成五（check_four）
+    Three,         //己方或对方的活四、双冲四点（check_three）
+    DoubleThree,   //双活三点（check_double_thread）
+    Search,        //MCTS
+    Solved         //复用的树里根节点已经证明了结局，不再搜索
+};
+
+struct MoveTelemetry{
+    int move_number=0;               //落子后棋盘上的棋子数
+    int row=-1,col=-1;
+    Decision decision=Decision::None;
+    long long playouts=0;
+    double seconds=0.0;              //墙钟时间，含启发式
+    double thread_seconds[PHASE_COUNT]={};   //各阶段所有线程耗时之和
+    long long selects=0;
+    long long depth_sum=0;           //各次选择到达的叶子深度之和
+    int max_depth=0;
+    std::size_t nodes=0;             //搜索结束后可达的节点数
+    std::size_t internal_nodes=0;    //其中已有子节点的
+    std::size_t children=0;          //这些节点的子节点数之和
+    int max_branching=0;
+    std::size_t tree_bytes=0;
+    std::size_t table_slots=0;       //置换表的槽数，表在开启置换时一次分配，不会扩容
+    double table_load=0.0;           //已分配节点数占槽数的比例，未开启置换时为0
+    std::size_t evicted=0;
+
+    double average_depth() const noexcept{ return selects==0? 0.0:1.0*depth_sum/selects; }
+    double average_branching() const noexcept{ return internal_nodes==0? 0.0:1.0*children/internal_nodes; }
+    std::string ToJson() const;     //一行JSON，不含换行
+};
+
+const char* decision_name(Decision decision) noexcept;
+
+//单个搜索线程的计数，线程结束时合并进MoveTelemetry，热路径上不碰共享变量
+struct ThreadTelemetry{
+    double seconds[PHASE_COUNT]={};
+    long long selects=0;
+    long long depth_sum=0;
+    int max_depth=0;
+
+    void depth(int d) noexcept{
+        selects++;
+        depth_sum+=d;
+        if(d>max_depth) max_depth=d;
+    }
+    void merge_into(MoveTelemetry& move) const noexcept;
+};
+
+//分段计时：每次lap把上次lap以来的时间记到给定阶段
+class PhaseClock{
+
+public:
+    explicit PhaseClock(ThreadTelemetry& counters) noexcept: counters(counters),last(std::chrono::steady_clock::now()){}
+    void lap(Phase phase) noexcept{
+        auto now=std::chrono::steady_clock::now();
+        counters.seconds[static_cast<int>(phase)]+=std::chrono::duration<double>(now-last).count();
+        last=now;
+    }
+
+private:
+    ThreadTelemetry& counters;
+    std::chrono::steady_clock::time_point last;
+
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,50 @@
+#ifndef THREATINDEX_H
+#define THREATINDEX_H
+
+#include "config.h"
+#include "pattern.h"
+#include <utility>
+#include <vector>
+
+//棋盘格子的集合，每行一个uint16_t
+struct CellSet{
+    uint16_t row[BOARD_ROWS]={0};
+
+    void set(int r,int c) noexcept{ row[r]|=static_cast<uint16_t>(1u<<c); }
+    void reset(int r,int c) noexcept{ row[r]&=static_cast<uint16_t>(~(1u<<c)); }
+    bool test(int r,int c) const noexcept{ return (row[r]>>c)&1u; }
+    std::pair<int,int> first() const noexcept;          //按行优先顺序的第一个格子，集合为空时返回{-1,-1}
+    int count() const noexcept;
+};
+
+//威胁索引：缓存每个空位在四个方向上对双方的棋型，以及由此得到的成五、冲四、活四、双三位点
+//每次落子只会改变经过该子的四条线上前后4格的窗口，所以update只需重查这至多40个格子
+//整个索引是定长的值类型（约2.5KB），可以按局面复制，在搜索树中随落子增量更新
+class ThreatIndex{
+
+public:
+    void reset(const ChessBoard& board,const std::vector<std::vector<Diaginfo>>& diag_map);   //由完整棋盘重建
+    void update(int r,int c,Player player);                                                  //在(r,c)落下player的棋子后增量更新
+
+    Shape shape(Player player,int r,int c,int dir) const noexcept{ return static_cast<Shape>(shapes[side(player)][r][c][dir]); }
+    const BitBoard& stones(Player player) const noexcept{ return bitboards[side(player)]; }
+
+    const CellSet& win_squares(Player player) const noexcept{ return win[side(player)]; }                   //落子即成五
+    const CellSet& four_squares(Player player) const noexcept{ return four[side(player)]; }                 //落子成冲四或活四，对方必须应
+    const CellSet& live_four_squares(Player player) const noexcept{ return live_four[side(player)]; }       //落子成五、活四或双冲四，对方挡不住
+    const CellSet& double_three_squares(Player player) const noexcept{ return double_three[side(player)]; } //落子形成两个及以上活三或四
+
+private:
+    static int side(Player player) noexcept{ return (player==Player::Black)? 0:1; }
+    void refresh(int r,int c,int dir);          //重查一个空位在一个方向上双方的棋型
+    void classify(int r,int c);                 //根据四个方向的棋型更新该格在各集合中的归属
+    void remove(int r,int c);                   //格子被占后从所有集合中移除
+
+    const std::vector<std::vector<Diaginfo>>* diag_map=nullptr;
+    BitBoard bitboards[2];
+    uint8_t shapes[2][BOARD_ROWS][BOARD_COLS][4]={};
+    CellSet win[2],four[2],live_four[2],double_three[2];
+
+};
+
+#endif // THREATINDEX_H
@@ -0,0 +1,137 @@
+#include "threatIndex.h"
+#include "bitBoard.h"
+#include <cstring>
+
+static const int DIR_R[4]={0,1,1,1};      //与line_shape的方向编号一致：横、竖、主对角、副对角
+static const int DIR_C[4]={1,0,1,-1};
+
+std::pair<int,int> CellSet::first() const noexcept{
+    for(int i=0;i<BOARD_ROWS;i++){
+        if(row[i]!=0) return {i,__builtin_ctz(row[i])};
+    }
+    return {-1,-1};
+}
+
+int CellSet::count() const noexcept{
+    int cnt=0;
+    for(int i=0;i<BOARD_ROWS;i++){
+        cnt+=__builtin_popcount(row[i]);
+    }
+    return cnt;
+}
+
+void ThreatIndex::reset(const ChessBoard& board,const std::vector<std::vector<Diaginfo>>& diag_map){
+    this->diag_map=&diag_map;
+    bitboards[0]=BitBoard{};
+    bitboards[1]=BitBoard{};
+    place_piece(board,bitboards[0],bitboards[1],diag_map);
+    for(int s=0;s<2;s++){
+        win[s]=CellSet{};
+        four[s]=CellSet{};
+        live_four[s]=CellSet{};
+        double_three[s]=CellSet{};
+    }
+    std::memset(shapes,0,sizeof(shapes));
+    //某个方向上前后SHAPE_WINDOW格内没有棋子时，双方在这个方向都是Shape::None，不必查表；四个方向都没有时也不属于任何集合
+    const uint32_t window=(1u<<(2*SHAPE_WINDOW+1))-1;
+    auto near=[&](uint16_t black,uint16_t white,int p){ return ((static_cast<uint32_t>(black|white)<<SHAPE_WINDOW)>>p&window)!=0; };
+    for(int i=0;i<BOARD_ROWS;i++){
+        for(int j=0;j<BOARD_COLS;j++){
+            if(board.grid[i][j]!=Player::None) continue;
+            const Diaginfo& d=diag_map[i][j];
+            bool lines[4]={near(bitboards[0].row[i],bitboards[1].row[i],j),
+                           near(bitboards[0].col[j],bitboards[1].col[j],i),
+                           near(bitboards[0].diag1[d.diag1_id],bitboards[1].diag1[d.diag1_id],d.diag1_off),
+                           near(bitboards[0].diag2[d.diag2_id],bitboards[1].diag2[d.diag2_id],d.diag2_off)};
+            if(!(lines[0]||lines[1]||lines[2]||lines[3])) continue;
+            for(int dir=0;dir<4;dir++){
+                if(lines[dir]) refresh(i,j,dir);
+            }
+            classify(i,j);
+        }
+    }
+}
+
+void ThreatIndex::update(int r,int c,Player player){
+    place_a_piece(bitboards[0],bitboards[1],*diag_map,r,c,player);
+    remove(r,c);
+    //只有经过(r,c)的四条线上前后SHAPE_WINDOW格的窗口看得到这一子，再多一格是因为它可能把相邻的五连变成长连
+    //同一条线上的格子共用双方的线掩码，沿线移动时位置逐格加一；棋型都没变的格子不必重新归类
+    const Diaginfo& d=(*diag_map)[r][c];
+    for(int dir=0;dir<4;dir++){
+        uint16_t own[2];
+        int len,p;
+        switch(dir){
+        case 0: own[0]=bitboards[0].row[r]; own[1]=bitboards[1].row[r]; len=BOARD_COLS; p=c; break;
+        case 1: own[0]=bitboards[0].col[c]; own[1]=bitboards[1].col[c]; len=BOARD_ROWS; p=r; break;
+        case 2: own[0]=bitboards[0].diag1[d.diag1_id]; own[1]=bitboards[1].diag1[d.diag1_id]; len=BOARD_COLS-(r>c? r-c:c-r); p=d.diag1_off; break;
+        default: own[0]=bitboards[0].diag2[d.diag2_id]; own[1]=bitboards[1].diag2[d.diag2_id]; len=BOARD_COLS-(r+c>BOARD_COLS-1? r+c-(BOARD_COLS-1):(BOARD_COLS-1)-(r+c)); p=d.diag2_off; break;
+        }
+        for(int k=-SHAPE_WINDOW-1;k<=SHAPE_WINDOW+1;k++){
+            int q=p+k;
+            if(k==0||q<0||q>=len||((own[0]|own[1])>>q&1u)) continue;
+            int i=r+k*DIR_R[dir],j=c+k*DIR_C[dir];
+            bool changed=false;
+            for(int s=0;s<2;s++){
+                Shape shape=SHAPE_TABLE[shape_index(own[s],own[1-s],len,q)];
+                if(shape==Shape::Five&&run_length(static_cast<uint16_t>(own[s]|(1u<<q)),q)!=5) shape=Shape::None;    //窗口边缘的五连可能是长连
+                if(shapes[s][i][j][dir]!=static_cast<uint8_t>(shape)){
+                    shapes[s][i][j][dir]=static_cast<uint8_t>(shape);
+                    changed=true;
+                }
+            }
+            if(changed) classify(i,j);
+        }
+    }
+}
+
+void ThreatIndex::refresh(int r,int c,int dir){
+    for(int s=0;s<2;s++){
+        const BitBoard& own=bitboards[s];
+        Shape shape=line_shape(own,bitboards[1-s],*diag_map,r,c,dir);
+        if(shape==Shape::Five){             //窗口边缘的五连可能是长连，用整条线确认
+            BitBoard temp=own,other{};
+            place_a_piece(temp,other,*diag_map,r,c,Player::Black);
+            const Diaginfo& d=(*diag_map)[r][c];
+            int len;
+            switch(dir){
+            case 0: len=run_length(temp.row[r],c); break;
+            case 1: len=run_length(temp.col[c],r); break;
+            case 2: len=run_length(temp.diag1[d.diag1_id],d.diag1_off); break;
+            default: len=run_length(temp.diag2[d.diag2_id],d.diag2_off); break;
+            }
+            if(len!=5) shape=Shape::None;
+        }
+        shapes[s][r][c][dir]=static_cast<uint8_t>(shape);
+    }
+}
+
+void ThreatIndex::classify(int r,int c){
+    for(int s=0;s<2;s++){
+        int fours=0,threes=0;
+        bool five=false,open_four=false;
+        for(int dir=0;dir<4;dir++){
+            Shape shape=static_cast<Shape>(shapes[s][r][c][dir]);
+            if(shape==Shape::Five) five=true;
+            if(shape==Shape::OpenFour) open_four=true;
+            if(shape==Shape::Four||shape==Shape::OpenFour) fours++;
+            if(shape>=Shape::BrokenThree) threes++;
+        }
+        if(five) win[s].set(r,c); else win[s].reset(r,c);
+        if(fours>0) four[s].set(r,c); else four[s].reset(r,c);
+        if(five||open_four||fours>=2) live_four[s].set(r,c); else live_four[s].reset(r,c);
+        if(threes>=2) double_three[s].set(r,c); else double_three[s].reset(r,c);
+    }
+}
+
+void ThreatIndex::remove(int r,int c){
+    for(int s=0;s<2;s++){
+        for(int dir=0;dir<4;dir++){
+            shapes[s][r][c][dir]=static_cast<uint8_t>(Shape::None);
+        }
+        win[s].reset(r,c);
+        four[s].reset(r,c);
+        live_four[s].reset(r,c);
+        double_three[s].reset(r,c);
+    }
+}
@@ -0,0 +1,304 @@
+//自对弈比赛：两种搜索配置对下，按胜率估计Elo差，可用SPRT提前停止，不依赖Qt
+//用法：
+//  Gomoku_match 结果文件 --a 配置 --b 配置 [--games 局数] [--concurrency 并发局数] [--openings 开局文件] [--seed 种子]
+//               [--sprt elo0,elo1] [--alpha 0.05] [--beta 0.05]
+//配置是逗号分隔的key=value：playouts=每步模拟次数 seconds=每步秒数 threads=线程数 batch=批量 dag=0/1
+//                          parallel=tree/root c=UCB探索系数 memory=搜索树内存上限(MB) rollout=uniform（默认）/pattern
+//                          attack=8个冒号分隔的权重 defend=同上 local=附近挑点的百分比 samples=附近抽取的空位数（见RolloutPolicy）
+//                          rave=RAVE的等价访问次数，0为关闭 solver=0/1
+//种子同时决定随机开局和搜索线程的随机数；只有--concurrency 1、threads=1且按playouts限制时整场比赛才能完全复现
+//每个开局下两局并交换先后手；开局文件每行一个开局，形如"7,7 6,8 8,8"（行,列，黑先），不给时按种子在中央随机摆三子
+//结果文件每局一行：局号 开局号 a执黑(1/0) 结果(a胜1 和0.5 a负0) 手数 a用时 b用时
+#include "GomokuGame.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Engine{
+    SearchConfig config;
+    SearchLimits limits;
+};
+
+struct Options{
+    std::string out;
+    Engine a,b;
+    std::string openings;
+    long long games=1000;                 //最多下的局数，向上取偶数使每个开局两种先后手都下到
+    int concurrency=0;                    //同时进行的对局数，0表示按核数和每局线程数自动决定
+    unsigned seed=1;
+    bool sprt=false;
+    double elo0=0.0,elo1=5.0;             //H0：a比b强elo0，H1：强elo1
+    double alpha=0.05,beta=0.05;
+};
+
+using Line=std::vector<std::pair<int,int>>;     //开局的落子序列，黑先
+
+bool parse_weights(const char* text,uint16_t (&weights)[8]){      //冒号分隔的8个权重，按Shape的顺序
+    int read=0;
+    for(const char* p=text;read<8;read++){
+        char* end;
+        long value=std::strtol(p,&end,10);
+        if(end==p||value<0||value>65535) return false;
+        weights[read]=static_cast<uint16_t>(value);
+        if(*end!=':') break;
+        p=end+1;
+    }
+    return read==7;
+}
+
+bool parse_engine(const char* text,Engine& engine){
+    std::stringstream in(text);
+    std::string item;
+    while(std::getline(in,item,',')){
+        std::size_t eq=item.find('=');
+        if(eq==std::string::npos) return false;
+        std::string key=item.substr(0,eq);
+        const char* value=item.c_str()+eq+1;
+        if(key=="playouts") engine.limits.playouts=std::atoll(value);
+        else if(key=="seconds") engine.limits.seconds=std::atof(value);
+        else if(key=="threads") engine.config.threads=std::atoi(value);
+        else if(key=="batch") engine.config.batch=std::atoi(value);
+        else if(key=="dag") engine.config.transpositions=std::atoi(value)!=0;
+        else if(key=="parallel") engine.config.parallel=(std::strcmp(value,"root")==0)? ParallelMode::Root:ParallelMode::Tree;
+        else if(key=="c") engine.config.exploration=std::atof(value);
+        else if(key=="rollout"){
+            if(std::strcmp(value,"uniform")==0) engine.config.rollout.mode=RolloutMode::Uniform;
+            else if(std::strcmp(value,"pattern")==0) engine.config.rollout.mode=RolloutMode::Pattern;
+            else return false;
+        }
+        else if(key=="attack"){ if(!parse_weights(value,engine.config.rollout.attack)) return false; }
+        else if(key=="defend"){ if(!parse_weights(value,engine.config.rollout.defend)) return false; }
+        else if(key=="local") engine.config.rollout.local_percent=static_cast<uint8_t>(std::atoi(value));
+        else if(key=="samples") engine.config.rollout.samples=static_cast<uint8_t>(std::atoi(value));
+        else if(key=="rave") engine.config.rave=std::atof(value);
+        else if(key=="solver") engine.config.solver=std::atoi(value)!=0;
+        else if(key=="memory"){
+            engine.config.memory_budget=static_cast<std::size_t>(std::atof(value)*1024*1024);
+            engine.config.when_full=TreeFullPolicy::Evict;
+        }
+        else return false;
+    }
+    return engine.config.threads>0;
+}
+
+bool parse(int argc,char* argv[],Options& options){
+    //结果文件必须放在最前面；-h、--help或漏写文件名时第一个参数以-开头，不能把它当文件名创建
+    if(argc<2||argv[1][0]=='-') return false;
+    if((argc-2)%2!=0) return false;          //选项都成对出现，多出一个说明漏写了值
+    options.out=argv[1];
+    bool a=false,b=false;
+    for(int i=2;i+1<argc;i+=2){
+        if(std::strcmp(argv[i],"--a")==0){ if(!parse_engine(argv[i+1],options.a)) return false; a=true; }
+        else if(std::strcmp(argv[i],"--b")==0){ if(!parse_engine(argv[i+1],options.b)) return false; b=true; }
+        else if(std::strcmp(argv[i],"--games")==0) options.games=std::atoll(argv[i+1]);
+        else if(std::strcmp(argv[i],"--concurrency")==0) options.concurrency=std::atoi(argv[i+1]);
+        else if(std::strcmp(argv[i],"--openings")==0) options.openings=argv[i+1];
+        else if(std::strcmp(argv[i],"--seed")==0) options.seed=static_cast<unsigned>(std::atoll(argv[i+1]));
+        else if(std::strcmp(argv[i],"--sprt")==0){
+            options.sprt=std::sscanf(argv[i+1],"%lf,%lf",&options.elo0,&options.elo1)==2;
+            if(!options.sprt) return false;
+        }
+        else if(std::strcmp(argv[i],"--alpha")==0) options.alpha=std::atof(argv[i+1]);
+        else if(std::strcmp(argv[i],"--beta")==0) options.beta=std::atof(argv[i+1]);
+        else return false;
+    }
+    return a&&b&&options.games>0&&options.alpha>0.0&&options.beta>0.0;      //两方的配置都要明确给出
+}
+
+bool load_openings(const std::string& path,std::vector<Line>& openings){
+    std::ifstream in(path);
+    if(!in) return false;
+    std::string text;
+    while(std::getline(in,text)){
+        std::istringstream line(text);
+        Line opening;
+        int row,col;
+        char comma;
+        while(line>>row>>comma>>col){
+            if(comma!=','||row<0||row>=BOARD_ROWS||col<0||col>=BOARD_COLS) return false;
+            opening.push_back({row,col});
+        }
+        if(!opening.empty()) openings.push_back(opening);
+    }
+    return !openings.empty();
+}
+
+//中央7×7内随机摆黑白黑三子，三子还构不成威胁，每个开局双方各执一次黑，开局本身的偏向相互抵消
+std::vector<Line> random_openings(std::size_t count,unsigned seed){
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> cell(BOARD_ROWS/2-3,BOARD_ROWS/2+3);
+    std::vector<Line> openings;
+    while(openings.size()<count){
+        Line opening;
+        ChessBoard board;
+        while(opening.size()<3){
+            int row=cell(rng),col=cell(rng);
+            if(board.grid[row][col]!=Player::None) continue;
+            board.grid[row][col]=(opening.size()%2==0)? Player::Black:Player::White;
+            opening.push_back({row,col});
+        }
+        openings.push_back(opening);
+    }
+    return openings;
+}
+
+//一局棋：双方各用一个GomokuGame，每步的落子同时告诉两边，返回a的得分
+double play(const Options& options,const Line& opening,bool a_black,int& plies,double seconds[2]){
+    GomokuGame games[2];             //0是a，1是b
+    const Engine* engines[2]={&options.a,&options.b};
+    for(int e=0;e<2;e++){
+        games[e].SetSearchConfig(engines[e]->config);
+        games[e].StartGame(false);
+        seconds[e]=0.0;
+    }
+    plies=0;
+    for(std::size_t i=0;i<opening.size();i++){
+        Player player=(i%2==0)? Player::Black:Player::White;
+        games[0].Make_Move(opening[i].first,opening[i].second,player);
+        games[1].Make_Move(opening[i].first,opening[i].second,player);
+        plies++;
+    }
+    while(games[0].CheckWinner()==Player::None&&!games[0].is_full()){
+        Player player=games[0].GetCurPlayer();
+        int e=((player==Player::Black)==a_black)? 0:1;
+        auto start=std::chrono::steady_clock::now();
+        std::pair<int,int> move=games[e].GetAIMove(engines[e]->limits);
+        seconds[e]+=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        if(move.first<0||!games[0].Make_Move(move.first,move.second,player)){
+            return e==0? 0.0:1.0;        //没有合法落子按负处理，理论上不会出现
+        }
+        games[1].Make_Move(move.first,move.second,player);
+        plies++;
+    }
+    Player winner=games[0].CheckWinner();
+    if(winner==Player::None) return 0.5;
+    return ((winner==Player::Black)==a_black)? 1.0:0.0;
+}
+
+struct Score{
+    long long wins=0,draws=0,losses=0;
+
+    long long games() const noexcept{ return wins+draws+losses; }
+    double mean() const noexcept{ return (wins+0.5*draws)/games(); }
+    double variance() const noexcept{      //单局得分的方差
+        double x=mean();
+        return (wins*(1.0-x)*(1.0-x)+draws*(0.5-x)*(0.5-x)+losses*x*x)/games();
+    }
+};
+
+double elo_of(double score){
+    score=std::min(std::max(score,1e-6),1.0-1e-6);
+    return -400.0*std::log10(1.0/score-1.0);
+}
+
+double score_of(double elo){
+    return 1.0/(1.0+std::pow(10.0,-elo/400.0));
+}
+
+//胜、和、负三项结果的广义SPRT，对数似然比用得分均值和方差的正态近似
+double llr(const Score& score,double elo0,double elo1){
+    double var=score.variance();
+    if(score.games()==0||var<=0.0) return 0.0;
+    double s0=score_of(elo0),s1=score_of(elo1);
+    return score.games()*(s1-s0)*(2.0*score.mean()-s0-s1)/(2.0*var);
+}
+
+}
+
+int main(int argc,char* argv[]){
+    Options options;
+    if(!parse(argc,argv,options)){
+        std::fprintf(stderr,"usage: %s results.txt --a key=value,... --b key=value,... [--games N] [--concurrency N] [--openings file] [--seed N]"
+                            " [--sprt elo0,elo1] [--alpha F] [--beta F]\n"
+                            "--seed seeds the openings and the search; a run repeats exactly only with --concurrency 1, threads=1 and playouts=\n"
+                            "engine keys: playouts seconds threads batch dag parallel c memory rollout attack defend local samples rave solver\n",argv[0]);
+        return 2;
+    }
+    seed_rollouts(options.seed);
+    long long pairs=(options.games+1)/2;
+    std::vector<Line> openings;
+    if(!options.openings.empty()){
+        if(!load_openings(options.openings,openings)){
+            std::fprintf(stderr,"cannot read openings from %s\n",options.openings.c_str());
+            return 1;
+        }
+    }
+    else openings=random_openings(static_cast<std::size_t>(std::min<long long>(pairs,100000)),options.seed);
+    int concurrency=options.concurrency;
+    if(concurrency<=0){
+        int per_game=std::max(options.a.config.threads,options.b.config.threads);     //同一局里两边轮流思考，不会同时占用线程
+        concurrency=std::max(1,static_cast<int>(std::thread::hardware_concurrency())/per_game);
+    }
+    std::FILE* out=std::fopen(options.out.c_str(),"w");
+    if(out==nullptr){
+        std::fprintf(stderr,"cannot write %s\n",options.out.c_str());
+        return 1;
+    }
+
+    double lower=std::log(options.beta/(1.0-options.alpha)),upper=std::log((1.0-options.beta)/options.alpha);
+    std::atomic<long long> next{0};
+    std::atomic<bool> decided{false};
+    std::mutex mutex;
+    Score score;
+    double llr_now=0.0;
+    auto worker=[&]{
+        while(!decided.load(std::memory_order_relaxed)){
+            long long game=next.fetch_add(1);
+            if(game>=2*pairs) break;
+            std::size_t opening=static_cast<std::size_t>(game/2)%openings.size();
+            bool a_black=game%2==0;
+            int plies;
+            double seconds[2];
+            double result=play(options,openings[opening],a_black,plies,seconds);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(result==1.0) score.wins++;
+            else if(result==0.0) score.losses++;
+            else score.draws++;
+            std::fprintf(out,"%lld %zu %d %g %d %.3f %.3f\n",game,opening,a_black? 1:0,result,plies,seconds[0],seconds[1]);
+            std::fflush(out);
+            if(options.sprt){
+                llr_now=llr(score,options.elo0,options.elo1);
+                if(llr_now<=lower||llr_now>=upper) decided.store(true,std::memory_order_relaxed);
+            }
+            if(score.games()%10==0||decided.load(std::memory_order_relaxed)){
+                std::fprintf(stderr,"games %lld: +%lld =%lld -%lld, elo %+.1f",score.games(),score.wins,score.draws,score.losses,elo_of(score.mean()));
+                if(options.sprt) std::fprintf(stderr,", llr %.2f (%.2f, %.2f)",llr_now,lower,upper);
+                std::fprintf(stderr,"\n");
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(int t=0;t<concurrency;t++){
+        workers.emplace_back(worker);
+    }
+    for(auto& thread : workers){
+        thread.join();
+    }
+    std::fclose(out);
+
+    if(score.games()==0) return 1;
+    double margin=1.96*std::sqrt(score.variance()/score.games());      //得分均值的95%置信区间，再换算成Elo
+    double elo=elo_of(score.mean());
+    std::printf("games %lld: +%lld =%lld -%lld, score %.3f, elo %+.1f [%+.1f, %+.1f]\n",score.games(),score.wins,score.draws,score.losses,
+                score.mean(),elo,elo_of(score.mean()-margin),elo_of(score.mean()+margin));
+    if(options.sprt){
+        const char* verdict=llr_now>=upper? "H1 accepted (a is stronger)":(llr_now<=lower? "H0 accepted":"inconclusive");
+        std::printf("sprt [%g, %g] llr %.2f (%.2f, %.2f): %s\n",options.elo0,options.elo1,llr_now,lower,upper,verdict);
+    }
+    return 0;
+}